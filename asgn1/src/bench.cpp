@@ -0,0 +1,242 @@
+// $Id: bench.cpp,v 1.3 2026-10-17 12:00:00-07 - - $
+
+//
+// ybench -
+//    Benchmarks for the bigint kernels.  By default times each of
+//    + - * / % ^ and decimal parse and print at operand sizes from
+//    1 digit up by factors of 10.  With -c it instead times ubigint
+//    multiplication on either side of each of the multiplication
+//    cutoffs, to find where the cutoffs belong.  Output is tab
+//    separated records, one per measurement, with comment lines
+//    starting with '#' giving the column names or the measured
+//    crossover points.
+//
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+using namespace std;
+
+#include <unistd.h>
+
+#include "bigint.h"
+#include "libfns.h"
+#include "profile.h"
+#include "ubigint.h"
+#include "util.h"
+
+static double min_seconds = 0.05;
+
+//
+// random_digits -
+//    A random string of exactly the given number of decimal
+//    digits, with no leading zero.
+//
+string random_digits (mt19937_64& generator, size_t digits) {
+   string text (digits, '0');
+   text[0] = '1' + generator() % 9;
+   for (size_t pos = 1; pos < digits; ++pos) {
+      text[pos] = '0' + generator() % 10;
+   }
+   return text;
+}
+
+//
+// random_ubigint -
+//    A random value of exactly the given number of limbs: the
+//    number of decimal digits is chosen so that the smallest and
+//    largest values both have that many limbs.
+//
+ubigint random_ubigint (mt19937_64& generator, size_t limbs) {
+   size_t digits = floor (limbs * ubigint::LIMB_BITS * log10 (2.0));
+   return ubigint (random_digits (generator, digits));
+}
+
+//
+// time_per_op -
+//    Repeat the operation, doubling the count, until it runs for
+//    at least min_seconds, and return nanoseconds and allocations
+//    per operation.
+//
+struct per_op { double nanos; double allocs; };
+
+template <typename operation>
+per_op time_per_op (operation oper) {
+   using clock = chrono::steady_clock;
+   for (size_t count = 1; ; count *= 2) {
+      size_t allocs_before = allocation_count();
+      auto start = clock::now();
+      for (size_t iter = 0; iter < count; ++iter) oper();
+      chrono::duration<double> elapsed = clock::now() - start;
+      size_t allocs = allocation_count() - allocs_before;
+      if (elapsed.count() >= min_seconds) {
+         return {elapsed.count() * 1e9 / count,
+                 static_cast<double> (allocs) / count};
+      }
+   }
+}
+
+//
+// sweep_cutoff -
+//    For each size, time one multiplication with the cutoff just
+//    above the operand size (so the cheaper algorithm runs) and
+//    just at it (so one level of the next algorithm runs on top
+//    of the current cutoffs).  Prints
+//       mul <cutoff> <limbs> <ns/op below> <ns/op above>
+//    and returns the first size at which the higher algorithm
+//    won twice in a row.
+//
+size_t sweep_cutoff (const string& name, size_t& cutoff,
+                     size_t min_limbs, size_t max_limbs) {
+   size_t saved = cutoff;
+   mt19937_64 generator;
+   size_t measured = 0;
+   int wins = 0;
+   for (size_t limbs = min_limbs; limbs <= max_limbs;
+        limbs += max<size_t> (1, limbs / 8)) {
+      ubigint left = random_ubigint (generator, limbs);
+      ubigint right = random_ubigint (generator, limbs);
+      cutoff = limbs + 1;
+      double below = time_per_op ([&]() { left * right; }).nanos;
+      cutoff = limbs;
+      double above = time_per_op ([&]() { left * right; }).nanos;
+      cutoff = saved;
+      cout << "mul\t" << name << "\t" << limbs << "\t"
+           << static_cast<long> (below) << "\t"
+           << static_cast<long> (above) << endl;
+      wins = above < below ? wins + 1 : 0;
+      if (measured == 0 and wins == 2) measured = limbs;
+   }
+   cout << "# " << name << " measured " << measured
+        << " current " << saved << endl;
+   return measured;
+}
+
+void bench_mul (size_t max_limbs) {
+   static constexpr size_t NEVER = numeric_limits<size_t>::max();
+   size_t saved_toom3 = ubigint::toom3_threshold;
+   size_t saved_ntt = ubigint::ntt_threshold;
+   ubigint::toom3_threshold = NEVER;
+   ubigint::ntt_threshold = NEVER;
+   sweep_cutoff ("karatsuba_threshold", ubigint::karatsuba_threshold,
+                 4, max_limbs / 16);
+   ubigint::toom3_threshold = saved_toom3;
+   sweep_cutoff ("toom3_threshold", ubigint::toom3_threshold,
+                 ubigint::karatsuba_threshold, max_limbs / 4);
+   ubigint::ntt_threshold = saved_ntt;
+   sweep_cutoff ("ntt_threshold", ubigint::ntt_threshold,
+                 ubigint::toom3_threshold, max_limbs);
+}
+
+//
+// null_streambuf -
+//    Discards its output, so that printing is timed without the
+//    cost of storing or writing the digits.
+//
+class null_streambuf: public streambuf {
+   protected:
+      int overflow (int chr) override { return chr; }
+      streamsize xsputn (const char*, streamsize count) override {
+         return count;
+      }
+};
+
+//
+// bench_kernels -
+//    For each size from 1 digit to max_digits by factors of 10,
+//    prints
+//       kernel <op> <digits> <ns/op> <allocs/op>
+//    where + - * take two operands of that many digits, / and %
+//    divide a dividend of twice that many digits by one of that
+//    many, ^ raises a value of an eighth that many digits to the
+//    8th power, and parse and print convert a value of that many
+//    digits from and to decimal.
+//
+void bench_kernels (size_t max_digits) {
+   mt19937_64 generator;
+   null_streambuf discard;
+   ostream null_out (&discard);
+   cout << "# kernel\top\tdigits\tns/op\tallocs/op" << endl
+        << fixed << setprecision (2);
+   for (size_t digits = 1; digits <= max_digits; digits *= 10) {
+      string text = random_digits (generator, digits);
+      bigint left {string_view (text)};
+      bigint right {random_digits (generator, digits)};
+      bigint dividend {random_digits (generator, 2 * digits)};
+      bigint base {random_digits (generator, (digits + 7) / 8)};
+      bigint exponent {8};
+      auto report = [&] (const char* name, per_op result) {
+         cout << "kernel\t" << name << "\t" << digits << "\t"
+              << static_cast<long> (result.nanos) << "\t"
+              << result.allocs << endl;
+      };
+      report ("+", time_per_op ([&]() { left + right; }));
+      report ("-", time_per_op ([&]() { left - right; }));
+      report ("*", time_per_op ([&]() { left * right; }));
+      report ("/", time_per_op ([&]() { dividend / right; }));
+      report ("%", time_per_op ([&]() { dividend % right; }));
+      report ("^", time_per_op ([&]() { pow (base, exponent); }));
+      report ("parse", time_per_op ([&]() {
+                 bigint {string_view (text)};
+              }));
+      report ("print", time_per_op ([&]() { null_out << left; }));
+   }
+}
+
+//
+// main -
+//    -c          sweep the multiplication cutoffs instead
+//    -d digits   largest operand size for the kernels
+//    -l limbs    largest operand size for the cutoff sweep
+//    -n          use the scalar add, subtract and compare kernels
+//    -s seconds  minimum time spent on each measurement
+//    -t threads  most threads one multiplication may use
+//    -@ flags    debug flags
+//
+int main (int argc, char** argv) {
+   exec::execname (argv[0]);
+   count_allocations();
+   bool cutoffs = false;
+   size_t max_digits = 1000000;
+   size_t max_limbs = 8000;
+   opterr = 0;
+   for (;;) {
+      int option = getopt (argc, argv, "@:cd:l:ns:t:");
+      if (option == EOF) break;
+      switch (option) {
+         case '@':
+            debugflags::setflags (optarg);
+            break;
+         case 'c':
+            cutoffs = true;
+            break;
+         case 'd':
+            max_digits = stoul (optarg);
+            break;
+         case 'l':
+            max_limbs = stoul (optarg);
+            break;
+         case 'n':
+            ubigint::vector_kernels = false;
+            break;
+         case 's':
+            min_seconds = stod (optarg);
+            break;
+         case 't':
+            ubigint::thread_limit = max (stoi (optarg), 1);
+            break;
+         default:
+            error() << "-" << static_cast<char> (optopt)
+                    << ": invalid option" << endl;
+            break;
+      }
+   }
+   if (cutoffs) bench_mul (max_limbs);
+           else bench_kernels (max_digits);
+   return exec::status();
+}
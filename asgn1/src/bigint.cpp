@@ -11,17 +11,22 @@ using namespace std;
 #include "debug.h"
 #include "relops.h"
 
-bigint::bigint (long that): uvalue (that), is_negative (that < 0) {
+bigint::bigint (long that):
+                uvalue (that < 0 ? -static_cast<unsigned long> (that)
+                                 : that),
+                is_negative (that < 0) {
    DEBUGF ('~', this << " -> " << uvalue)
 }
 
 bigint::bigint (const ubigint& uvalue_, bool is_negative_):
                 uvalue(uvalue_), is_negative(is_negative_) {
+   fix_zero_sign();
 }
 
-bigint::bigint (const string& that) {
+bigint::bigint (string_view that) {
    is_negative = that.size() > 0 and that[0] == '_';
    uvalue = ubigint (that.substr (is_negative ? 1 : 0));
+   fix_zero_sign();
 }
 
 bigint bigint::operator+ () const {
@@ -32,73 +37,98 @@ bigint bigint::operator- () const {
    return {uvalue, not is_negative};
 }
 /* My code begins */
-bigint bigint::operator+ (const bigint& that) const {
-   bigint x {*this}, y {that}, result;
-   if (!x.is_negative && !y.is_negative) { // (+, +)
-      result.uvalue = x.uvalue + y.uvalue;
-      result.is_negative = false;
-   } else if (!x.is_negative && y.is_negative) { // (+, -)
-      y.is_negative = false;
-      result = x - y;
-   } else if (x.is_negative && !y.is_negative) { // (-, +)
-      x.is_negative = false;
-      result = y - x;
-   } else { // (-, -)
-      x.is_negative = false;
-      y.is_negative = false;
-      result = x + y;
-      result.is_negative = true;
+
+//
+// add_signed -
+//    Adds that, taken as having sign that_negative, so that
+//    subtraction is addition of the negation without a copy.
+//
+bigint& bigint::add_signed (const bigint& that, bool that_negative) {
+   if (is_negative == that_negative) {
+      uvalue += that.uvalue;
+   }else if (uvalue >= that.uvalue) {
+      uvalue -= that.uvalue;
+   }else {
+      uvalue = that.uvalue - uvalue;
+      is_negative = that_negative;
    }
+   fix_zero_sign();
+   return *this;
+}
+
+bigint& bigint::operator+= (const bigint& that) {
+   return add_signed (that, that.is_negative);
+}
+
+bigint& bigint::operator-= (const bigint& that) {
+   return add_signed (that, not that.is_negative);
+}
+
+bigint& bigint::operator*= (const bigint& that) {
+   uvalue *= that.uvalue;
+   is_negative = is_negative != that.is_negative;
+   fix_zero_sign();
+   return *this;
+}
+
+bigint& bigint::operator/= (const bigint& that) {
+   uvalue /= that.uvalue;
+   is_negative = is_negative != that.is_negative;
+   fix_zero_sign();
+   return *this;
+}
+
+bigint& bigint::operator%= (const bigint& that) {
+   uvalue %= that.uvalue;
+   is_negative = is_negative != that.is_negative;
+   fix_zero_sign();
+   return *this;
+}
+
+void bigint::divmod (const bigint& divisor, bigint& remainder) {
+   uvalue.divmod (divisor.uvalue, remainder.uvalue);
+   is_negative = is_negative != divisor.is_negative;
+   remainder.is_negative = is_negative;
+   fix_zero_sign();
+   remainder.fix_zero_sign();
+}
+
+bigint& bigint::operator<<= (size_t bits) {
+   uvalue <<= bits;
+   return *this;
+}
+
+bigint& bigint::operator>>= (size_t bits) {
+   uvalue >>= bits;
+   fix_zero_sign();
+   return *this;
+}
+
+bigint bigint::operator+ (const bigint& that) const {
+   bigint result {*this};
+   result += that;
    return result;
 }
 
 bigint bigint::operator- (const bigint& that) const {
-   bigint x {*this}, y {that}, result;
-   if (!x.is_negative && !y.is_negative) { // (+, +)
-      if (x.uvalue >= y.uvalue) {
-         result.uvalue = x.uvalue - y.uvalue;
-         result.is_negative = false;
-      } else {
-         result.uvalue = y.uvalue - x.uvalue;
-         result.is_negative = true;
-      }
-   } else if (!x.is_negative && y.is_negative) { // (+, -)
-      y.is_negative = false;
-      result = x + y;
-      result.is_negative = false;
-   } else if (x.is_negative && !y.is_negative) { // (-, +)
-      x.is_negative = false;
-      result = x + y;
-      result.is_negative = true;
-   } else { // (-, -)
-      x.is_negative = false;
-      y.is_negative = false;
-      result = x - y;
-      result.is_negative = !result.is_negative;
-     
-   }
+   bigint result {*this};
+   result -= that;
    return result;
 }
 
-
 bigint bigint::operator* (const bigint& that) const {
-   bigint x {*this}, y {that}, result;
-   result.uvalue = x.uvalue * y.uvalue;
-   result.is_negative = (x.is_negative && y.is_negative) || (!x.is_negative && !y.is_negative) ? false : true;
-   return result;
+   return {uvalue * that.uvalue, is_negative != that.is_negative};
 }
 
 bigint bigint::operator/ (const bigint& that) const {
-   bigint x {*this}, y {that}, result;
-   result.uvalue = x.uvalue / y.uvalue;
-   result.is_negative =	(x.is_negative && y.is_negative) || (!x.is_negative && !y.is_negative) ? false : true;
+   bigint result {*this};
+   result /= that;
    return result;
 }
 
 bigint bigint::operator% (const bigint& that) const {
-   bigint x {*this}, y {that}, result;
-   result.uvalue = x.uvalue % y.uvalue;
-   result.is_negative = (x.is_negative && y.is_negative) || (!x.is_negative && !y.is_negative) ? false : true;
+   bigint result {*this};
+   result %= that;
    return result;
 }
 
@@ -111,11 +141,6 @@ bool bigint::operator< (const bigint& that) const {
    return is_negative ? uvalue > that.uvalue
                       : uvalue < that.uvalue;
 }
-
-void bigint::operator= (const bigint& that) {
-   uvalue = that.uvalue;
-   is_negative = that.is_negative;
-}
 /* My code ends */
 
 ostream& operator<< (ostream& out, const bigint& that) {
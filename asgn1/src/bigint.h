@@ -18,12 +18,20 @@ class bigint {
    private:
       ubigint uvalue;
       bool is_negative {false};
+      bigint& add_signed (const bigint&, bool that_negative);
+      void fix_zero_sign() {
+         if (uvalue.is_zero()) is_negative = false;
+      }
    public:
 
       bigint() = default; // Needed or will be suppressed.
+      bigint (const bigint&) = default;
+      bigint (bigint&&) noexcept = default;
+      bigint& operator= (const bigint&) = default;
+      bigint& operator= (bigint&&) noexcept = default;
       bigint (long);
       bigint (const ubigint&, bool is_negative = false);
-      explicit bigint (const string&);
+      explicit bigint (string_view);
 
       bigint operator+() const;
       bigint operator-() const;
@@ -34,9 +42,24 @@ class bigint {
       bigint operator/ (const bigint&) const;
       bigint operator% (const bigint&) const;
 
+      // In place versions, see ubigint.  Shifts and divmod act on
+      // the magnitude, like / and % do.
+      bigint& operator+= (const bigint&);
+      bigint& operator-= (const bigint&);
+      bigint& operator*= (const bigint&);
+      bigint& operator/= (const bigint&);
+      bigint& operator%= (const bigint&);
+      bigint& operator<<= (size_t bits);
+      bigint& operator>>= (size_t bits);
+      void divmod (const bigint& divisor, bigint& remainder);
+
+      bool is_zero() const { return uvalue.is_zero(); }
+      bool is_odd() const { return uvalue.is_odd(); }
+      bool negative() const { return is_negative; }
+      const ubigint& magnitude() const { return uvalue; }
+
       bool operator== (const bigint&) const;
       bool operator<  (const bigint&) const;
-      void operator= (const bigint&);
 };
 
 #endif
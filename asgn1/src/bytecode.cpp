@@ -0,0 +1,134 @@
+// $Id: bytecode.cpp,v 1.1 2026-10-17 12:00:00-07 - - $
+
+#include <iomanip>
+#include <iostream>
+#include <string_view>
+using namespace std;
+
+#include "bytecode.h"
+#include "debug.h"
+
+bool program::dump = false;
+
+static const char* const opcode_names[] {
+   "push", "add", "sub", "mul", "div", "mod", "pow", "powmod",
+   "sqrt", "gcd", "factorial", "setprec", "getprec", "debug",
+   "clear", "dup", "printall", "print", "quit", "execute", "store",
+   "load", "pushreg", "popreg", "less", "greater", "equal", "noreg",
+   "unknown", "end",
+};
+static_assert (size (opcode_names) == OPCODE_COUNT);
+
+//
+// operator_code -
+//    The opcode of an operator token, and for a register operator
+//    the register it names.
+//
+static instruction operator_code (string_view lexinfo) {
+   char oper = lexinfo[0];
+   switch (oper) {
+      case '+': return opcode::ADD;
+      case '-': return opcode::SUB;
+      case '*': return opcode::MUL;
+      case '/': return opcode::DIV;
+      case '%': return opcode::MOD;
+      case '^': return opcode::POW;
+      case '|': return opcode::POWMOD;
+      case 'v': return opcode::SQRT;
+      case 'G': return opcode::GCD;
+      case 'F': return opcode::FACTORIAL;
+      case 'k': return opcode::SETPREC;
+      case 'K': return opcode::GETPREC;
+      case 'Y': return opcode::DEBUG;
+      case 'c': return opcode::CLEAR;
+      case 'd': return opcode::DUP;
+      case 'f': return opcode::PRINTALL;
+      case 'p': return opcode::PRINT;
+      case 'q': return opcode::QUIT;
+      case 'x': return opcode::EXECUTE;
+   }
+   opcode op;
+   switch (oper) {
+      case 's': op = opcode::STORE;   break;
+      case 'l': op = opcode::LOAD;    break;
+      case 'S': op = opcode::PUSHREG; break;
+      case 'L': op = opcode::POPREG;  break;
+      case '<': op = opcode::LESS;    break;
+      case '>': op = opcode::GREATER; break;
+      case '=': op = opcode::EQUAL;   break;
+      default : return {opcode::UNKNOWN,
+                        static_cast<unsigned char> (oper)};
+   }
+   if (lexinfo.size() < 2) return opcode::NOREG;
+   return {op, static_cast<unsigned char> (lexinfo[1])};
+}
+
+program_ptr compile (scanner& input, bool partial, size_t limit) {
+   program_ptr result = make_shared<program>();
+   for (;;) {
+      token lexeme = input.scan();
+      switch (lexeme.symbol) {
+         case tsymbol::SCANEOF:
+            break;
+         case tsymbol::NUMBER:
+            result->code.emplace_back (opcode::PUSH,
+                                       result->constants.size());
+            result->constants.emplace_back (
+                                 decimal (lexeme.lexinfo));
+            break;
+         case tsymbol::STRING:
+            result->code.emplace_back (opcode::PUSH,
+                                       result->constants.size());
+            result->constants.emplace_back (lexeme.lexinfo);
+            break;
+         case tsymbol::OPERATOR:
+            result->code.push_back (operator_code (lexeme.lexinfo));
+            break;
+      }
+      if (lexeme.symbol == tsymbol::SCANEOF) break;
+      if (partial and not input.buffered()) break;
+      if (result->code.size() >= limit) break;
+   }
+   result->code.emplace_back (opcode::END);
+   if (program::dump) cerr << *result;
+   return result;
+}
+
+ostream& operator<< (ostream& out, opcode op) {
+   return out << opcode_names[static_cast<size_t> (op)];
+}
+
+//
+// operator<< (program) -
+//    One line for each instruction, with its constant or register.
+//
+ostream& operator<< (ostream& out, const program& prog) {
+   out << "program " << &prog << ": " << prog.code.size()
+       << " instructions, " << prog.constants.size()
+       << " constants" << endl;
+   for (size_t addr = 0; addr < prog.code.size(); ++addr) {
+      const instruction& instr = prog.code[addr];
+      out << setw (6) << addr << "  " << instr.op;
+      string_view name = opcode_names[static_cast<size_t> (instr.op)];
+      string pad (9 - name.size(), ' ');
+      switch (instr.op) {
+         case opcode::PUSH: {
+            const ydc_value& value = prog.constants[instr.operand];
+            out << pad << "#" << instr.operand << " ";
+            if (value.is_string()) out << "[" << value << "]";
+                              else out << value;
+            break;
+         }
+         case opcode::STORE: case opcode::LOAD:
+         case opcode::PUSHREG: case opcode::POPREG:
+         case opcode::LESS: case opcode::GREATER: case opcode::EQUAL:
+         case opcode::UNKNOWN:
+            out << pad << static_cast<char> (instr.operand);
+            break;
+         default:
+            break;
+      }
+      out << endl;
+   }
+   return out;
+}
@@ -0,0 +1,88 @@
+// $Id: bytecode.h,v 1.1 2026-10-17 12:00:00-07 - - $
+
+#ifndef __BYTECODE_H__
+#define __BYTECODE_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <vector>
+using namespace std;
+
+#include "scanner.h"
+#include "value.h"
+
+//
+// opcode -
+//    One per thing a token can do.  The register operators carry
+//    the register, PUSH the index of its constant and UNKNOWN the
+//    operator character, all in instruction::operand.  END closes
+//    every program.
+//
+enum class opcode: uint8_t {
+   PUSH, ADD, SUB, MUL, DIV, MOD, POW, POWMOD, SQRT, GCD, FACTORIAL,
+   SETPREC, GETPREC, DEBUG, CLEAR, DUP, PRINTALL, PRINT, QUIT,
+   EXECUTE, STORE, LOAD, PUSHREG, POPREG, LESS, GREATER, EQUAL,
+   NOREG, UNKNOWN, END,
+};
+constexpr size_t OPCODE_COUNT = size_t (opcode::END) + 1;
+
+//
+// instruction -
+//    The interpreter fills in target, the address of the code that
+//    runs the opcode, the first time the program is run, and then
+//    dispatches straight through it without looking at op again.
+//
+struct instruction {
+   const void* target {nullptr};
+   opcode op;
+   uint32_t operand;
+   instruction (opcode op_, uint32_t operand_ = 0):
+                op(op_), operand(operand_) {
+   }
+};
+
+//
+// program -
+//    The compiled form of a script or macro.  Numbers are parsed
+//    once, when compiled, and kept with the strings as constants
+//    that PUSH shares onto the stack.  A program that is run only
+//    once, as the main input is, may instead move them there.
+//
+struct program {
+   vector<instruction> code;
+   vector<ydc_value> constants;
+   bool run_once {false};
+   bool linked {false};
+   // Whether compile writes each program it makes to cerr.
+   static bool dump;
+};
+using program_ptr = shared_ptr<program>;
+
+//
+// compile -
+//    Compiles tokens from input up to its end, or with partial,
+//    only as far as the input already read takes it, so that a
+//    terminal is still run a line at a time.  It also stops once
+//    limit instructions have been compiled.
+//
+program_ptr compile (scanner& input, bool partial = false,
+                     size_t limit = SIZE_MAX);
+
+//
+// program_source -
+//    Where the interpreter gets its main input, compiled a piece at
+//    a time into programs that are run once.
+//
+class program_source {
+   public:
+      virtual ~program_source() = default;
+      // The next piece of input, or nullptr at the end of it.
+      virtual program_ptr next() = 0;
+};
+
+ostream& operator<< (ostream&, opcode);
+ostream& operator<< (ostream&, const program&);
+
+#endif
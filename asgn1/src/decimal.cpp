@@ -0,0 +1,178 @@
+// $Id: decimal.cpp,v 1.1 2026-10-17 12:00:00-07 - - $
+
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <utility>
+using namespace std;
+
+#include "decimal.h"
+#include "libfns.h"
+
+decimal::decimal (const bigint& value_, size_t scale):
+                  value (value_), scale_ (scale) {
+}
+
+decimal::decimal (bigint&& value_, size_t scale):
+                  value (move (value_)), scale_ (scale) {
+}
+
+decimal::decimal (string_view that) {
+   size_t point = that.find ('.');
+   if (point == string_view::npos) {
+      value = bigint (that);
+      return;
+   }
+   string digits (that.substr (0, point));
+   digits.append (that.substr (point + 1));
+   value = bigint (digits);
+   scale_ = that.size() - point - 1;
+}
+
+//
+// aligned -
+//    The value as it would be at a scale no less than this one's.
+//
+bigint decimal::aligned (size_t scale) const {
+   if (scale == scale_) return value;
+   return value * bigint (ubigint::power_of_10 (scale - scale_));
+}
+
+bigint decimal::integer() const {
+   if (scale_ == 0) return value;
+   return value / bigint (ubigint::power_of_10 (scale_));
+}
+
+void decimal::rescale (size_t scale) {
+   if (scale > scale_) {
+      value *= bigint (ubigint::power_of_10 (scale - scale_));
+   }else if (scale < scale_) {
+      value /= bigint (ubigint::power_of_10 (scale_ - scale));
+   }
+   scale_ = scale;
+}
+
+decimal& decimal::operator+= (const decimal& that) {
+   if (that.scale_ > scale_) rescale (that.scale_);
+   if (that.scale_ == scale_) value += that.value;
+                         else value += that.aligned (scale_);
+   return *this;
+}
+
+decimal& decimal::operator-= (const decimal& that) {
+   if (that.scale_ > scale_) rescale (that.scale_);
+   if (that.scale_ == scale_) value -= that.value;
+                         else value -= that.aligned (scale_);
+   return *this;
+}
+
+//
+// multiply -
+//    The exact product has the sum of the scales, and is cut back
+//    to the largest of precision and the operands' scales.
+//
+decimal& decimal::multiply (const decimal& that, size_t precision) {
+   size_t wanted = min (scale_ + that.scale_,
+                        max ({precision, scale_, that.scale_}));
+   value *= that.value;
+   scale_ += that.scale_;
+   rescale (wanted);
+   return *this;
+}
+
+//
+// divide -
+//    The dividend is first scaled so that one integer division
+//    leaves the quotient at precision places.
+//
+decimal& decimal::divide (const decimal& that, size_t precision) {
+   rescale (precision + that.scale_);
+   value /= that.value;
+   scale_ = precision;
+   return *this;
+}
+
+//
+// remainder -
+//    What is left of the magnitude after taking away the divisor
+//    times the quotient at precision places, with the sign rule of
+//    bigint's %, at the larger of this scale and precision plus the
+//    divisor's.  For integers at precision 0, that is just %.
+//
+decimal& decimal::remainder (const decimal& that, size_t precision) {
+   if (scale_ == 0 and that.scale_ == 0 and precision == 0) {
+      value %= that.value;
+      return *this;
+   }
+   bool negative = value.negative() != that.value.negative();
+   decimal product (*this);
+   product.divide (that, precision);
+   product.value *= that.value;
+   product.scale_ += that.scale_;
+   size_t wanted = max (scale_, product.scale_);
+   rescale (wanted);
+   product.rescale (wanted);
+   value = bigint (value.magnitude() - product.value.magnitude(),
+                   negative);
+   return *this;
+}
+
+bool decimal::operator== (const decimal& that) const {
+   if (scale_ == that.scale_) return value == that.value;
+   if (scale_ < that.scale_) return aligned (that.scale_) == that.value;
+   return value == that.aligned (scale_);
+}
+
+bool decimal::operator< (const decimal& that) const {
+   if (scale_ == that.scale_) return value < that.value;
+   if (scale_ < that.scale_) return aligned (that.scale_) < that.value;
+   return value < that.aligned (scale_);
+}
+
+//
+// pow -
+//    The exact power has scale times the exponent places, and is
+//    cut back to the larger of precision and the base's scale.
+//
+decimal pow (const decimal& base, const bigint& exponent,
+             size_t precision) {
+   size_t count = exponent.magnitude().bits_from (0);
+   decimal result (pow (base.unscaled(), bigint (exponent.magnitude())),
+                   base.scale() * count);
+   if (exponent.negative()) {
+      decimal one (1);
+      return one.divide (result, precision);
+   }
+   result.rescale (min (result.scale(),
+                        max (precision, base.scale())));
+   return result;
+}
+
+decimal sqrt (const decimal& value, size_t precision) {
+   size_t scale = max (precision, value.scale());
+   decimal square (value);
+   square.rescale (2 * scale);
+   return {isqrt (square.unscaled()), scale};
+}
+
+//
+// operator<< -
+//    As dc prints: no 0 before the point, and trailing zeros kept
+//    to the scale.  Zero is just 0.
+//
+ostream& operator<< (ostream& out, const decimal& that) {
+   if (that.scale_ == 0 or that.value.is_zero()) {
+      return out << that.value;
+   }
+   ostringstream digits;
+   digits << that.value.magnitude();
+   string text = digits.str();
+   if (that.value.negative()) out << '-';
+   if (text.size() <= that.scale_) {
+      return out << '.' << string (that.scale_ - text.size(), '0')
+                 << text;
+   }
+   size_t point = text.size() - that.scale_;
+   return out << string_view (text).substr (0, point) << '.'
+              << string_view (text).substr (point);
+}
@@ -0,0 +1,68 @@
+// $Id: decimal.h,v 1.1 2026-10-17 12:00:00-07 - - $
+
+#ifndef __DECIMAL_H__
+#define __DECIMAL_H__
+
+#include <cstddef>
+#include <iostream>
+#include <string_view>
+using namespace std;
+
+#include "bigint.h"
+#include "relops.h"
+
+//
+// decimal -
+//    A number with scale digits after the decimal point, kept as
+//    the bigint value * 10^scale.  Sums keep the larger scale of
+//    their operands; the other operations follow dc, where the
+//    scale of a product, quotient, remainder, power or root also
+//    depends on the precision set by k.  Digits past the scale
+//    are truncated, toward zero.  Scales are brought into line
+//    with ubigint::power_of_10, and a number with no fraction
+//    costs no more than the bigint it holds.
+//
+class decimal {
+   friend ostream& operator<< (ostream&, const decimal&);
+   private:
+      bigint value;
+      size_t scale_ {0};
+      bigint aligned (size_t scale) const;
+   public:
+      decimal() = default;
+      decimal (const bigint& value_, size_t scale = 0);
+      decimal (bigint&& value_, size_t scale = 0);
+      // Digits with an optional point, with _ for a minus sign.
+      explicit decimal (string_view);
+
+      size_t scale() const { return scale_; }
+      const bigint& unscaled() const { return value; }
+      bool is_zero() const { return value.is_zero(); }
+      bool negative() const { return value.negative(); }
+      // The integer part, truncated toward zero.
+      bigint integer() const;
+      // Changes to exactly scale digits after the point.
+      void rescale (size_t scale);
+
+      decimal& operator+= (const decimal&);
+      decimal& operator-= (const decimal&);
+      decimal& multiply (const decimal&, size_t precision);
+      // The divisor must not be zero.
+      decimal& divide (const decimal&, size_t precision);
+      decimal& remainder (const decimal&, size_t precision);
+
+      bool operator== (const decimal&) const;
+      bool operator<  (const decimal&) const;
+};
+
+// base^exponent, for the integer part of exponent.  A negative
+// exponent gives 1 / base^-exponent to precision places, and
+// base must then not be zero.
+decimal pow (const decimal& base, const bigint& exponent,
+             size_t precision);
+
+// The square root to the larger of precision and the scale of
+// value.  value must not be negative.
+decimal sqrt (const decimal& value, size_t precision);
+
+#endif
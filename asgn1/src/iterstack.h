@@ -1,4 +1,4 @@
-// $Id: iterstack.h,v 1.13 2014-06-26 17:21:55-07 - - $
+// $Id: iterstack.h,v 1.14 2026-10-17 12:00:00-07 - - $
 
 // 
 // The class std::stack does not provide an iterator, which is
@@ -12,7 +12,10 @@
 // 
 // No implementation file is needed because all functions are
 // inherited, and the convenience functions that are added are
-// trivial, and so can be inline.
+// trivial, and so can be inline.  Values are moved rather than
+// copied wherever they can be:  push and emplace construct in
+// place, pop_value moves the top out, and popn discards several
+// at once.
 //
 // Any underlying container which supports the necessary operations
 // could be used, such as vector, list, or deque.
@@ -21,6 +24,7 @@
 #ifndef __ITERSTACK_H__
 #define __ITERSTACK_H__
 
+#include <utility>
 #include <vector>
 using namespace std;
 
@@ -33,16 +37,34 @@ class iterstack: private vector<value_type> {
       using stack_t::push_back;
       using stack_t::pop_back;
       using stack_t::back;
+      using stack_t::emplace_back;
+      using stack_t::erase;
       using const_iterator = typename stack_t::const_reverse_iterator;
    public:
       using stack_t::clear;
       using stack_t::empty;
       using stack_t::size;
-      inline const_iterator begin() {return crbegin();}
-      inline const_iterator end() {return crend();}
+      using stack_t::reserve;
+      using stack_t::capacity;
+      inline const_iterator begin() const {return crbegin();}
+      inline const_iterator end() const {return crend();}
       inline void push (const value_type& value) {push_back (value);}
+      inline void push (value_type&& value) {push_back (move (value));}
+      template <typename... args_t>
+      inline value_type& emplace (args_t&&... args) {
+         return emplace_back (forward<args_t> (args)...);
+      }
       inline void pop() {pop_back();}
+      inline value_type pop_value() {
+         value_type result = move (back());
+         pop_back();
+         return result;
+      }
+      inline void popn (size_t count) {
+         erase (stack_t::end() - count, stack_t::end());
+      }
       inline const value_type& top() const {return back();}
+      inline value_type& top() {return back();}
 };
 
 #endif
@@ -1,34 +1,262 @@
-// $Id: libfns.cpp,v 1.4 2015-07-03 14:46:41-07 - - $
+// $Id: libfns.cpp,v 1.5 2026-10-17 12:00:00-07 - - $
+
+#include <bit>
+#include <cstdint>
+#include <utility>
+#include <vector>
+using namespace std;
 
 #include "libfns.h"
 
 //
-// This algorithm would be more efficient with operators
-// *=, /=2, and is_odd.  But we leave it here.
+// window_pow -
+//    Left to right k-ary sliding window exponentiation, reading
+//    the exponent's bits directly.  The odd powers base^1, base^3,
+//    ... base^(2^k-1) are precomputed, then each run of up to k
+//    bits ending in a 1 costs one multiplication after the
+//    squarings.  multiply may be plain or modular.
 //
+template <typename value_t, typename multiply_t>
+value_t window_pow (const value_t& base, const ubigint& exponent,
+                    const value_t& one, multiply_t multiply) {
+   size_t bits = exponent.bit_length();
+   if (bits == 0) return one;
+   size_t window = bits <= 8 ? 1 : bits <= 24 ? 2 : bits <= 80 ? 3
+                 : bits <= 240 ? 4 : bits <= 672 ? 5 : 6;
+   vector<value_t> odd_powers {base};
+   if (window > 1) {
+      value_t square = multiply (base, base);
+      for (size_t count = 1; count < size_t {1} << (window - 1);
+           ++count) {
+         odd_powers.push_back (multiply (odd_powers.back(), square));
+      }
+   }
+   value_t result = one;
+   bool started = false;
+   for (size_t pos = bits; pos > 0; ) {
+      if (not exponent.bit (pos - 1)) {
+         if (started) result = multiply (result, result);
+         --pos;
+         continue;
+      }
+      size_t low = pos > window ? pos - window : 0;
+      while (not exponent.bit (low)) ++low;
+      size_t digit = 0;
+      for (size_t index = pos; index-- > low; ) {
+         digit = digit << 1 | exponent.bit (index);
+      }
+      if (started) {
+         for (size_t count = low; count < pos; ++count) {
+            result = multiply (result, result);
+         }
+         result = multiply (result, odd_powers[digit >> 1]);
+      }else {
+         result = odd_powers[digit >> 1];
+         started = true;
+      }
+      pos = low;
+   }
+   return result;
+}
 
 bigint pow (const bigint& base_arg, const bigint& exponent_arg) {
-   bigint base (base_arg);
-   bigint exponent (exponent_arg);
    static const bigint ZERO (0);
    static const bigint ONE (1);
-   static const bigint TWO (2);
-   DEBUGF ('^', "base = " << base << ", exponent = " << exponent);
-   if (base == ZERO) return ZERO;
-   bigint result = ONE;
-   if (exponent < ZERO) {
-      base = ONE / base;
-      exponent = - exponent;
-   }
-   while (exponent > ZERO) {
-      if (exponent % TWO == ONE) {
-         result = result * base;
-         exponent = exponent - 1;
-      } else {
-         base = base * base;
-         exponent = exponent / 2;
+   DEBUGF ('^', "base = " << base_arg
+                << ", exponent = " << exponent_arg);
+   if (base_arg.is_zero()) return ZERO;
+   bigint base (base_arg);
+   if (exponent_arg < ZERO) base = ONE / base;
+   bigint result = window_pow (base, exponent_arg.magnitude(), ONE,
+                               [] (const bigint& left,
+                                   const bigint& right) {
+                                  return left * right;
+                               });
+   DEBUGF ('^', "result = " << result);
+   return result;
+}
+
+bigint powmod (const bigint& base, const bigint& exponent,
+               const bigint& modulus) {
+   DEBUGF ('^', "base = " << base << ", exponent = " << exponent
+                << ", modulus = " << modulus);
+   const ubigint& mod = modulus.magnitude();
+   const ubigint& power = exponent.magnitude();
+   ubigint residue = base.magnitude() % mod;
+   ubigint result;
+   if (mod.is_odd()) {
+      montgomery mont (mod);
+      result = mont.from_form (
+            window_pow (mont.to_form (residue), power,
+                        mont.to_form (1),
+                        [&mont] (const ubigint& left,
+                                 const ubigint& right) {
+                           return mont.multiply (left, right);
+                        }));
+   }else {
+      result = window_pow (residue, power, ubigint (1) % mod,
+                           [&mod] (const ubigint& left,
+                                   const ubigint& right) {
+                              ubigint product {left * right};
+                              product %= mod;
+                              return product;
+                           });
+   }
+   bool negative = (base.negative() and exponent.is_odd())
+                   != modulus.negative();
+   DEBUGF ('^', "result = " << result);
+   return {result, negative};
+}
+
+//
+// isqrt -
+//    Newton's iteration at doubling precision: each pass takes the
+//    root of the leading 2d bits of value from the root of the
+//    leading d bits with one division of about d bits by d/2, so
+//    the whole costs about as much as the last of those divisions.
+//    The root so found is exact or one too large.
+//
+bigint isqrt (const bigint& value) {
+   DEBUGF ('^', "value = " << value);
+   const ubigint& square = value.magnitude();
+   if (square.is_zero()) return value;
+   size_t half = (square.bit_length() - 1) / 2;
+   ubigint root (1);
+   size_t done = 0;
+   for (int step = bit_width (half); step-- > 0; ) {
+      size_t last = done;
+      done = half >> step;
+      ubigint part (square);
+      part >>= 2 * half - last - done + 1;
+      part /= root;
+      root <<= done - last - 1;
+      root += part;
+   }
+   if (root * root > square) root -= 1;
+   DEBUGF ('^', "result = " << root);
+   return root;
+}
+
+//
+// combine -
+//    left * lmult + right * rmult, known not to be negative.  The
+//    two multipliers are never both positive nor both negative.
+//
+static ubigint combine (const ubigint& left, int64_t lmult,
+                        const ubigint& right, int64_t rmult) {
+   if (lmult < 0 or rmult > 0) {
+      return combine (right, rmult, left, lmult);
+   }
+   ubigint result {left * ubigint (static_cast<uint64_t> (lmult))};
+   result -= right * ubigint (static_cast<uint64_t> (-rmult));
+   return result;
+}
+
+//
+// binary_gcd -
+//    Stein's algorithm, for values that fit in a udouble_t.
+//
+static ubigint::udouble_t binary_gcd (ubigint::udouble_t left,
+                                      ubigint::udouble_t right) {
+   if (left == 0) return right;
+   if (right == 0) return left;
+   int twos = countr_zero (left | right);
+   left >>= countr_zero (left);
+   do {
+      right >>= countr_zero (right);
+      if (left > right) swap (left, right);
+      right -= left;
+   }while (right != 0);
+   return left << twos;
+}
+
+//
+// gcd -
+//    Lehmer's algorithm (Knuth 4.5.2 Algorithm L).  The Euclidean
+//    steps are first run on the leading LEAD_BITS bits of both
+//    values alone, for as long as the quotients are certain to be
+//    the same as for the whole values, and the cofactors then
+//    applied to the whole values at once with multiplications by
+//    a single double limb.  Each round so removes most of LEAD_BITS
+//    bits for the cost of a few linear passes, where plain Euclid
+//    would take dozens of full divisions.  A round in which not
+//    even the first quotient is certain does one full division.
+//
+bigint gcd (const bigint& left_arg, const bigint& right_arg) {
+   static constexpr size_t LEAD_BITS = 62;
+   DEBUGF ('^', "left = " << left_arg << ", right = " << right_arg);
+   ubigint left = left_arg.magnitude();
+   ubigint right = right_arg.magnitude();
+   if (left < right) swap (left, right);
+   while (right.bit_length() > 2 * ubigint::LIMB_BITS) {
+      size_t shift = left.bit_length() - LEAD_BITS;
+      int64_t lhat = left.bits_from (shift);
+      int64_t rhat = right.bits_from (shift);
+      int64_t lmult0 = 1, rmult0 = 0, lmult1 = 0, rmult1 = 1;
+      while (rhat + lmult1 != 0 and rhat + rmult1 != 0) {
+         int64_t quotient = (lhat + lmult0) / (rhat + lmult1);
+         if (quotient != (lhat + rmult0) / (rhat + rmult1)) break;
+         lmult0 = exchange (lmult1, lmult0 - quotient * lmult1);
+         rmult0 = exchange (rmult1, rmult0 - quotient * rmult1);
+         lhat = exchange (rhat, lhat - quotient * rhat);
+      }
+      if (rmult0 == 0) {
+         left %= right;
+         swap (left, right);
+      }else {
+         ubigint next = combine (left, lmult1, right, rmult1);
+         left = combine (left, lmult0, right, rmult0);
+         right = move (next);
       }
    }
+   if (not right.is_zero()) {
+      left %= right;
+      left = binary_gcd (left.bits_from (0), right.bits_from (0));
+   }
+   DEBUGF ('^', "result = " << left);
+   return left;
+}
+
+//
+// odd_product -
+//    The product of the odd parts of the integers in [low,high),
+//    multiplied as a balanced tree so that the big products are
+//    of operands of about the same size and can use the fast
+//    multiplications.  The leaves pack as many factors as fit
+//    into a double limb before multiplying.
+//
+static ubigint odd_product (uint64_t low, uint64_t high) {
+   static constexpr uint64_t LEAF_COUNT = 32;
+   if (high - low > LEAF_COUNT) {
+      uint64_t middle = low + (high - low) / 2;
+      ubigint product {odd_product (low, middle)};
+      product *= odd_product (middle, high);
+      return product;
+   }
+   ubigint product (1);
+   uint64_t packed = 1;
+   for (uint64_t factor = low; factor < high; ++factor) {
+      uint64_t odd = factor >> countr_zero (factor);
+      if (packed > UINT64_MAX / odd) {
+         product *= ubigint (packed);
+         packed = 1;
+      }
+      packed *= odd;
+   }
+   product *= ubigint (packed);
+   return product;
+}
+
+//
+// factorial -
+//    n! is the product of the odd parts of 1 through n, shifted
+//    left by the n - popcount (n) factors of 2 among them.
+//
+bigint factorial (const bigint& value) {
+   DEBUGF ('^', "value = " << value);
+   uint64_t count = value.magnitude().bits_from (0);
+   ubigint result {odd_product (1, count + 1)};
+   result <<= count - popcount (count);
    DEBUGF ('^', "result = " << result);
    return result;
 }
@@ -1,7 +1,23 @@
-// $Id: libfns.h,v 1.2 2015-07-02 16:03:36-07 - - $
+// $Id: libfns.h,v 1.3 2026-10-17 12:00:00-07 - - $
 
 // Library functions not members of any class.
 
 #include "bigint.h"
 
-bigint pow (const bigint& base, const bigint& exponent);
\ No newline at end of file
+bigint pow (const bigint& base, const bigint& exponent);
+
+// (base ^ exponent) % modulus, with the sign rules of ^ and %,
+// but without forming the full power.  exponent must not be
+// negative and modulus must not be zero.
+bigint powmod (const bigint& base, const bigint& exponent,
+               const bigint& modulus);
+
+// The integer square root, the largest r with r * r <= value.
+// value must not be negative.
+bigint isqrt (const bigint& value);
+
+// The greatest common divisor of the magnitudes, never negative.
+bigint gcd (const bigint& left, const bigint& right);
+
+// value!, for value not negative and less than 2^32.
+bigint factorial (const bigint& value);
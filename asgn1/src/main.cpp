@@ -1,9 +1,14 @@
 // $Id: main.cpp,v 1.58 2019-04-05 16:29:31-07 - - $
 
+#include <algorithm>
 #include <cassert>
+#include <climits>
+#include <cstdlib>
 #include <deque>
 #include <iostream>
+#include <memory>
 #include <stdexcept>
+#include <system_error>
 #include <unordered_map>
 #include <utility>
 using namespace std;
@@ -11,141 +16,509 @@ using namespace std;
 #include <unistd.h>
 
 #include "bigint.h"
+#include "bytecode.h"
 #include "debug.h"
 #include "iterstack.h"
 #include "libfns.h"
+#include "profile.h"
 #include "scanner.h"
+#include "source.h"
 #include "util.h"
+#include "value.h"
 
-using bigint_stack = iterstack<bigint>;
+using value_stack = iterstack<ydc_value>;
+using register_file = value_stack[UCHAR_MAX + 1];
 
-void do_arith (bigint_stack& stack, const char oper) {
-   if (stack.size() < 2) throw ydc_exn ("stack empty");
-   bigint right = stack.top();
-   stack.pop();
+//
+// newline -
+//    Ends a line of output, which is flushed at once unless ydc
+//    runs in batch mode, where output is only written a buffer at
+//    a time.
+//
+bool batch_mode = false;
+
+ostream& newline (ostream& out) {
+   out.put ('\n');
+   if (not batch_mode) out.flush();
+   return out;
+}
+
+//
+// need_numbers -
+//    Checks that the stack holds at least count values and that
+//    the top count of them are numbers, before any are popped.
+//
+void need_numbers (const value_stack& stack, size_t count) {
+   if (stack.size() < count) throw ydc_exn ("stack empty");
+   auto value = stack.begin();
+   for (size_t nr = 0; nr < count; ++nr, ++value) {
+      if (value->is_string()) throw ydc_exn ("non-numeric value");
+   }
+}
+
+//
+// do_arith -
+//    The result replaces the left operand in place on the stack,
+//    and the right operand is moved off rather than copied.  The
+//    left operand is copied first only if it is shared.  Products,
+//    quotients, remainders and powers are cut to the scales set
+//    out in decimal, given the precision set by k.
+//
+void do_arith (value_stack& stack, const char oper, size_t precision) {
+   need_numbers (stack, 2);
+   auto operand = stack.begin();
+   const decimal& divisor = oper == '^' ? (++operand)->number()
+                                        : operand->number();
+   if (divisor.is_zero()) {
+      switch (oper) {
+         case '/': throw ydc_exn ("divide by zero");
+         case '%': throw ydc_exn ("remainder by zero");
+         case '^':
+            if (stack.top().number().negative()) {
+               throw ydc_exn ("divide by zero");
+            }
+      }
+   }
+   ydc_value right_value = stack.pop_value();
+   const decimal& right = right_value.number();
    DEBUGF ('d', "right = " << right);
-   bigint left = stack.top();
-   stack.pop();
+   decimal& left = stack.top().number_for_update();
    DEBUGF ('d', "left = " << left);
-   bigint result;
    switch (oper) {
-      case '+': result = left + right; break;
-      case '-': result = left - right; break;
-      case '*': result = left * right; break;
-      case '/': result = left / right; break;
-      case '%': result = left % right; break;
-      case '^': result = pow (left, right); break;
+      case '+': left += right; break;
+      case '-': left -= right; break;
+      case '*': left.multiply (right, precision); break;
+      case '/': left.divide (right, precision); break;
+      case '%': left.remainder (right, precision); break;
+      case '^': left = pow (left, right.integer(), precision); break;
       default: throw invalid_argument ("do_arith operator "s + oper);
    }
-   DEBUGF ('d', "result = " << result);
-   stack.push (result);
+   DEBUGF ('d', "result = " << left);
+}
+
+//
+// do_powmod -
+//    base exponent modulus | leaves (base ^ exponent) % modulus,
+//    taking the integer part of each.
+//
+void do_powmod (value_stack& stack, const char) {
+   need_numbers (stack, 3);
+   auto operand = stack.begin();
+   bigint modulus = operand->number().integer();
+   if (modulus.is_zero()) throw ydc_exn ("remainder by zero");
+   bigint exponent = (++operand)->number().integer();
+   if (exponent.negative()) throw ydc_exn ("negative exponent");
+   stack.popn (2);
+   bigint base = stack.top().number().integer();
+   DEBUGF ('d', "base = " << base << ", exponent = " << exponent
+                << ", modulus = " << modulus);
+   stack.top() = ydc_value (powmod (base, exponent, modulus));
+   DEBUGF ('d', "result = " << stack.top());
+}
+
+//
+// do_sqrt -
+//    v replaces the top number by its square root, to the larger
+//    of the precision and the number's own scale.
+//
+void do_sqrt (value_stack& stack, const char, size_t precision) {
+   need_numbers (stack, 1);
+   if (stack.top().number().negative()) {
+      throw ydc_exn ("square root of negative number");
+   }
+   decimal& number = stack.top().number_for_update();
+   number = sqrt (number, precision);
 }
 
-void do_clear (bigint_stack& stack, const char) {
+//
+// do_gcd -
+//    G replaces the top two numbers by the greatest common divisor
+//    of their integer parts.
+//
+void do_gcd (value_stack& stack, const char) {
+   need_numbers (stack, 2);
+   ydc_value right_value = stack.pop_value();
+   decimal& left = stack.top().number_for_update();
+   left = gcd (left.integer(), right_value.number().integer());
+}
+
+//
+// do_factorial -
+//    F replaces the top number n by the factorial of its integer
+//    part.
+//
+void do_factorial (value_stack& stack, const char) {
+   need_numbers (stack, 1);
+   bigint count = stack.top().number().integer();
+   if (count.negative()) {
+      throw ydc_exn ("factorial of negative number");
+   }
+   if (count.magnitude().bit_length() > 32) {
+      throw ydc_exn ("factorial argument too large");
+   }
+   stack.top() = ydc_value (factorial (count));
+}
+
+//
+// do_precision -
+//    k pops the number of places that quotients, roots and powers
+//    are taken to.
+//
+size_t do_precision (value_stack& stack) {
+   need_numbers (stack, 1);
+   bigint places = stack.top().number().integer();
+   if (places.negative()) throw ydc_exn ("negative precision");
+   if (places.magnitude().bit_length() > 32) {
+      throw ydc_exn ("precision too large");
+   }
+   stack.pop();
+   return places.magnitude().bits_from (0);
+}
+
+void do_clear (value_stack& stack, const char) {
    DEBUGF ('d', "");
    stack.clear();
 }
 
-
-void do_dup (bigint_stack& stack, const char) {
-   bigint top = stack.top();
+
+//
+// do_dup -
+//    Shares the top value rather than copying it.
+//
+void do_dup (value_stack& stack, const char) {
+   if (stack.size() < 1) throw ydc_exn ("stack empty");
+   ydc_value top = stack.top();
    DEBUGF ('d', top);
    stack.push (top);
 }
 
-void do_printall (bigint_stack& stack, const char) {
-   for (const auto& elem: stack) cout << elem << endl;
+void do_printall (value_stack& stack, const char) {
+   for (const auto& elem: stack) cout << elem << newline;
 }
 
-void do_print (bigint_stack& stack, const char) {
+void do_print (value_stack& stack, const char) {
    if (stack.size() < 1) throw ydc_exn ("stack empty");
-   cout << stack.top() << endl;
-}
-
-void do_debug (bigint_stack&, const char) {
-   cout << "Y not implemented" << endl;
+   cout << stack.top() << newline;
 }
 
 class ydc_quit: public exception {};
-void do_quit (bigint_stack&, const char) {
+void do_quit (value_stack&, const char) {
    throw ydc_quit();
 }
 
-void do_function (bigint_stack& stack, const char oper) {
+//
+// do_compare -
+//    <r, >r and =r pop two numbers and hold if the former top is
+//    less than, greater than or equal to the next.
+//
+bool do_compare (value_stack& stack, opcode oper) {
+   need_numbers (stack, 2);
+   auto operand = stack.begin();
+   const decimal& left = operand->number();
+   const decimal& right = (++operand)->number();
+   bool holds;
    switch (oper) {
-      case '+': do_arith    (stack, oper); break;
-      case '-': do_arith    (stack, oper); break;
-      case '*': do_arith    (stack, oper); break;
-      case '/': do_arith    (stack, oper); break;
-      case '%': do_arith    (stack, oper); break;
-      case '^': do_arith    (stack, oper); break;
-      case 'Y': do_debug    (stack, oper); break;
-      case 'c': do_clear    (stack, oper); break;
-      case 'd': do_dup      (stack, oper); break;
-      case 'f': do_printall (stack, oper); break;
-      case 'p': do_print    (stack, oper); break;
-      case 'q': do_quit     (stack, oper); break;
-      default : throw ydc_exn (octal (oper) + " is unimplemented");
+      case opcode::LESS:    holds = left < right; break;
+      case opcode::GREATER: holds = left > right; break;
+      case opcode::EQUAL:   holds = left == right; break;
+      default: throw invalid_argument ("do_compare opcode");
    }
+   stack.popn (2);
+   return holds;
 }
 
-
+//
+// operand_bits -
+//    The length of the longer of the top two numbers on the stack,
+//    as the size of the operands of the next instruction.
+//
+size_t operand_bits (const value_stack& stack) {
+   size_t bits = 0;
+   size_t count = 0;
+   for (auto value = stack.begin();
+        value != stack.end() and count < 2; ++value, ++count) {
+      if (value->is_string()) continue;
+      const bigint& number = value->number().unscaled();
+      bits = max (bits, number.magnitude().bit_length());
+   }
+   return bits;
+}
+
+//
+// frame -
+//    A program being run, and the next instruction to run in it.
+//
+struct frame {
+   program_ptr code;
+   const instruction* next;
+};
+
+//
+// interpreter -
+//    Compiles the input a piece at a time and runs it, along with
+//    the macros it calls, each compiled the first time it is run.
+//    Macros are kept on a stack of frames rather than run by
+//    recursion, and a macro called as the last thing another one
+//    does replaces it, so that a macro which loops by calling
+//    itself runs in constant space.  With a profiler, every
+//    instruction is first counted and timed by it.
+//
+class interpreter {
+   private:
+      value_stack stack;
+      register_file registers;
+      size_t precision {0};
+      vector<frame> frames;
+      program_source& input;
+      unique_ptr<profiler> profile;
+      value_stack& need_register (uint32_t name);
+      void dispatch();
+   public:
+      // Room for the stack to grow this deep before it moves.
+      static constexpr size_t INITIAL_DEPTH = 256;
+      explicit interpreter (program_source& input_): input (input_) {
+         stack.reserve (INITIAL_DEPTH);
+         if (profiler::enabled) profile = make_unique<profiler>();
+      }
+      void run();
+};
+
+value_stack& interpreter::need_register (uint32_t name) {
+   value_stack& reg = registers[name];
+   if (reg.empty()) {
+      throw ydc_exn ("register '"s + static_cast<char> (name)
+                     + "' is empty");
+   }
+   return reg;
+}
+
+//
+// dispatch -
+//    Runs instructions until the input is used up.  The code for
+//    each instruction ends by jumping straight to the code for the
+//    next through its target, a label address (a GNU extension),
+//    so there is no central switch.  An instruction that throws
+//    has already been stepped past, and dispatch may be called
+//    again to carry on after it.  When profiling, every target is
+//    profiled instead, which goes on to the real code.
+//
+//    sr pops the top of the stack into register r, replacing its
+//    top value; lr pushes a shared copy of that value.  Sr and Lr
+//    push onto and pop from the register as a stack of its own.
+//
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+void interpreter::dispatch() {
+   static const void* const targets[OPCODE_COUNT] {
+      &&push, &&add, &&sub, &&mul, &&div, &&mod, &&pow, &&powmod,
+      &&sqrt, &&gcd, &&factorial, &&setprec, &&getprec, &&debug,
+      &&clear, &&dup,
+      &&printall, &&print, &&quit, &&execute, &&store, &&load,
+      &&pushreg, &&popreg, &&less, &&greater, &&equal, &&noreg,
+      &&unknown, &&end,
+   };
+   const void* const profiled_target = &&profiled;
+   frame* current;
+   const instruction* instr;
+   auto enter = [&] (program_ptr code) {
+      if (not code->linked) {
+         for (instruction& each: code->code) {
+            each.target = profile != nullptr ? profiled_target
+                        : targets[static_cast<size_t> (each.op)];
+         }
+         code->linked = true;
+      }
+      const instruction* first = code->code.data();
+      frames.push_back ({move (code), first});
+      current = &frames.back();
+   };
+   auto call = [&] (const ydc_value& value) {
+      if (not value.is_string()) {
+         stack.push (value);
+         return;
+      }
+      program_ptr code = value.code();
+      if (current->next->op == opcode::END) frames.pop_back();
+      enter (move (code));
+   };
+   #define DISPATCH() { instr = current->next++; goto *instr->target; }
+
+   if (frames.empty()) goto end;
+   current = &frames.back();
+   DISPATCH();
+
+profiled:
+   profile->next (instr->op, operand_bits (stack));
+   goto *targets[static_cast<size_t> (instr->op)];
+
+push: {
+      ydc_value& constant = current->code->constants[instr->operand];
+      if (current->code->run_once) stack.push (move (constant));
+                              else stack.push (constant);
+      DISPATCH();
+   }
+add:       do_arith     (stack, '+', precision); DISPATCH();
+sub:       do_arith     (stack, '-', precision); DISPATCH();
+mul:       do_arith     (stack, '*', precision); DISPATCH();
+div:       do_arith     (stack, '/', precision); DISPATCH();
+mod:       do_arith     (stack, '%', precision); DISPATCH();
+pow:       do_arith     (stack, '^', precision); DISPATCH();
+powmod:    do_powmod    (stack, '|'); DISPATCH();
+sqrt:      do_sqrt      (stack, 'v', precision); DISPATCH();
+gcd:       do_gcd       (stack, 'G'); DISPATCH();
+factorial: do_factorial (stack, 'F'); DISPATCH();
+setprec:   precision = do_precision (stack); DISPATCH();
+getprec:
+   stack.emplace (decimal (static_cast<long> (precision)));
+   DISPATCH();
+clear:     do_clear     (stack, 'c'); DISPATCH();
+dup:       do_dup       (stack, 'd'); DISPATCH();
+printall:  do_printall  (stack, 'f'); DISPATCH();
+print:     do_print     (stack, 'p'); DISPATCH();
+quit:      do_quit      (stack, 'q'); DISPATCH();
+debug:
+   if (profile == nullptr) cout << "Y needs ydc -p" << newline;
+                      else profile->report (cout);
+   DISPATCH();
+execute:
+   // The computed goto in DISPATCH does not destroy what is still
+   // in scope, so top has to be gone before it is reached.
+   if (stack.empty()) throw ydc_exn ("stack empty");
+   {
+      ydc_value top = stack.pop_value();
+      call (top);
+   }
+   DISPATCH();
+store: {
+      if (stack.empty()) throw ydc_exn ("stack empty");
+      value_stack& reg = registers[instr->operand];
+      if (reg.empty()) reg.push (stack.pop_value());
+                  else reg.top() = stack.pop_value();
+      DISPATCH();
+   }
+load:
+   stack.push (need_register (instr->operand).top());
+   DISPATCH();
+pushreg:
+   if (stack.empty()) throw ydc_exn ("stack empty");
+   registers[instr->operand].push (stack.pop_value());
+   DISPATCH();
+popreg: {
+      value_stack& reg = need_register (instr->operand);
+      stack.push (reg.pop_value());
+      DISPATCH();
+   }
+less: greater: equal:
+   if (do_compare (stack, instr->op)) {
+      call (need_register (instr->operand).top());
+   }
+   DISPATCH();
+noreg:
+   throw ydc_exn ("register name missing");
+unknown:
+   throw ydc_exn (octal (static_cast<char> (instr->operand))
+                  + " is unimplemented");
+end:
+   if (not frames.empty()) frames.pop_back();
+   if (frames.empty()) {
+      program_ptr code = input.next();
+      if (code == nullptr) return;
+      enter (move (code));
+   }
+   current = &frames.back();
+   DISPATCH();
+   #undef DISPATCH
+}
+#pragma GCC diagnostic pop
+
+void interpreter::run() {
+   for (;;) {
+      try {
+         dispatch();
+         return;
+      }catch (ydc_exn& exn) {
+         cout << exn.what() << newline;
+      }
+   }
+}
+
+
 //
 // scan_options
-//    Options analysis:  The only option is -Dflags. 
+//    Options analysis:
+//    -@ flags    debug flags
+//    -b          batch mode: buffer output, read ahead on a thread
+//    -d          dump each program to stderr as it is compiled
+//    -p          profile each operator, for Y to report
+//    -t threads  most threads one multiplication may use
+//    An optional operand names a script file to read instead of
+//    stdin, with "-" meaning stdin.
 //
-void scan_options (int argc, char** argv) {
+const char* scan_options (int argc, char** argv) {
    opterr = 0;
    for (;;) {
-      int option = getopt (argc, argv, "@:");
+      int option = getopt (argc, argv, "@:bdpt:");
       if (option == EOF) break;
       switch (option) {
          case '@':
             debugflags::setflags (optarg);
             break;
+         case 'b':
+            batch_mode = true;
+            break;
+         case 'd':
+            program::dump = true;
+            break;
+         case 'p':
+            profiler::enabled = true;
+            count_allocations();
+            break;
+         case 't':
+            ubigint::thread_limit = max (atoi (optarg), 1);
+            break;
          default:
             error() << "-" << static_cast<char> (optopt)
                     << ": invalid option" << endl;
             break;
       }
    }
-   if (optind < argc) {
-      error() << "operand not permitted" << endl;
+   if (optind + 1 < argc) {
+      error() << "only one operand permitted" << endl;
    }
+   if (optind == argc or argv[optind] == "-"s) return nullptr;
+   return argv[optind];
 }
 
 
 //
-// Main function.
+// Main function.  In batch mode cout writes through a buffer of
+// OUTPUT_BUFFER_SIZE bytes.
 //
+constexpr size_t OUTPUT_BUFFER_SIZE = 1 << 20;
+
 int main (int argc, char** argv) {
    exec::execname (argv[0]);
-   scan_options (argc, argv);
-   bigint_stack operand_stack;
-   scanner input;
+   const char* filename = scan_options (argc, argv);
+   shared_ptr<scanner> input;
    try {
-      for (;;) {
-         try {
-            token lexeme = input.scan();
-            switch (lexeme.symbol) {
-               case tsymbol::SCANEOF:
-                  throw ydc_quit();
-                  break;
-               case tsymbol::NUMBER:
-                  operand_stack.push (bigint (lexeme.lexinfo));
-                  break;
-               case tsymbol::OPERATOR: {
-                  char oper = lexeme.lexinfo[0];
-                  do_function (operand_stack, oper);
-                  break;
-                  }
-               default:
-                  assert (false);
-            }
-         }catch (ydc_exn& exn) {
-            cout << exn.what() << endl;
-         }
-      }
+      input = filename == nullptr ? make_shared<scanner>()
+                                  : make_shared<scanner> (filename);
+   }catch (system_error& exn) {
+      error() << exn.what() << endl;
+      return exec::status();
+   }
+   unique_ptr<program_source> source;
+   if (batch_mode) {
+      static char output_buffer[OUTPUT_BUFFER_SIZE];
+      ios::sync_with_stdio (false);
+      cout.rdbuf()->pubsetbuf (output_buffer, OUTPUT_BUFFER_SIZE);
+      source = make_unique<pipelined_source> (move (input));
+   }else {
+      source = make_unique<inline_source> (move (input));
+   }
+   try {
+      interpreter ydc (*source);
+      ydc.run();
    }catch (ydc_quit&) {
       // Intentionally left empty.
    }
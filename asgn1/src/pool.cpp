@@ -0,0 +1,88 @@
+// $Id: pool.cpp,v 1.1 2026-10-17 12:00:00-07 - - $
+
+#include <algorithm>
+#include <bit>
+#include <new>
+using namespace std;
+
+#include "pool.h"
+
+size_t block_pool::cache_limit = size_t {64} << 20;
+
+//
+// Each free list is threaded through the first word of its
+// blocks.  Size class k holds blocks of 2^k bytes; the smallest
+// class is big enough to hold the link.
+//
+static constexpr size_t MIN_CLASS = 5;
+static constexpr size_t CLASSES = 64;
+
+struct free_block {
+   free_block* next;
+};
+
+//
+// The cache itself has no destructor, so that blocks freed by
+// static objects after a thread's destructors have run are still
+// handled: once the thread's closer has emptied the cache, they
+// go straight back to the heap.
+//
+struct pool_cache {
+   free_block* lists[CLASSES];
+   size_t cached_bytes;
+   bool closed;
+};
+
+static thread_local pool_cache cache {};
+
+struct pool_closer {
+   ~pool_closer() {
+      block_pool::release();
+      cache.closed = true;
+   }
+};
+
+static void open_cache() {
+   thread_local pool_closer closer;
+   (void) closer;
+}
+
+static size_t size_class (size_t bytes) {
+   return max<size_t> (bit_width (bytes - 1), MIN_CLASS);
+}
+
+void* block_pool::allocate (size_t& bytes) {
+   size_t klass = size_class (bytes);
+   bytes = size_t {1} << klass;
+   free_block* block = cache.lists[klass];
+   if (block == nullptr) return ::operator new (bytes);
+   cache.lists[klass] = block->next;
+   cache.cached_bytes -= bytes;
+   return block;
+}
+
+void block_pool::deallocate (void* block, size_t bytes) noexcept {
+   if (block == nullptr) return;
+   size_t klass = size_class (bytes);
+   bytes = size_t {1} << klass;
+   if (cache.closed or cache.cached_bytes + bytes > cache_limit) {
+      ::operator delete (block);
+      return;
+   }
+   if (cache.cached_bytes == 0) open_cache();
+   free_block* freed = static_cast<free_block*> (block);
+   freed->next = cache.lists[klass];
+   cache.lists[klass] = freed;
+   cache.cached_bytes += bytes;
+}
+
+void block_pool::release() noexcept {
+   for (auto& list: cache.lists) {
+      while (list != nullptr) {
+         free_block* next = list->next;
+         ::operator delete (list);
+         list = next;
+      }
+   }
+   cache.cached_bytes = 0;
+}
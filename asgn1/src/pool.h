@@ -0,0 +1,52 @@
+// $Id: pool.h,v 1.1 2026-10-17 12:00:00-07 - - $
+
+#ifndef __POOL_H__
+#define __POOL_H__
+
+#include <cstddef>
+using namespace std;
+
+//
+// block_pool -
+//    Recycles the heap blocks behind ubigint values and the
+//    scratch buffers of multiplication and division.  Block sizes
+//    are rounded up to a power of two, and a freed block goes on
+//    a free list for its size, one set of lists per thread, so
+//    that the temporaries of one operation are reused by the next
+//    instead of going back to malloc.  Up to cache_limit bytes
+//    are kept per thread; release frees all of the calling
+//    thread's cached blocks at once, as does thread exit.
+//
+class block_pool {
+   public:
+      static size_t cache_limit;
+      // bytes is rounded up to the size actually allocated.
+      static void* allocate (size_t& bytes);
+      static void deallocate (void* block, size_t bytes) noexcept;
+      static void release() noexcept;
+};
+
+//
+// pool_allocator -
+//    Standard allocator over block_pool, for vectors of limbs.
+//
+template <typename item_t>
+struct pool_allocator {
+   using value_type = item_t;
+   pool_allocator() = default;
+   template <typename other_t>
+   pool_allocator (const pool_allocator<other_t>&) {}
+   item_t* allocate (size_t count) {
+      size_t bytes = count * sizeof (item_t);
+      return static_cast<item_t*> (block_pool::allocate (bytes));
+   }
+   void deallocate (item_t* block, size_t count) noexcept {
+      block_pool::deallocate (block, count * sizeof (item_t));
+   }
+   template <typename other_t>
+   bool operator== (const pool_allocator<other_t>&) const {
+      return true;
+   }
+};
+
+#endif
@@ -0,0 +1,97 @@
+// $Id: profile.cpp,v 1.1 2026-10-17 12:00:00-07 - - $
+
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <new>
+using namespace std;
+
+#include "profile.h"
+
+//
+// operator new -
+//    Replaced so that every allocation, including those made by
+//    operator new[], is counted, once counting has been turned on.
+//    Until then it costs only a load of the flag.
+//
+static atomic<bool> counting {false};
+static atomic<size_t> allocations {0};
+
+void* operator new (size_t size) {
+   if (counting.load (memory_order_relaxed)) {
+      allocations.fetch_add (1, memory_order_relaxed);
+   }
+   void* result = malloc (size == 0 ? 1 : size);
+   if (result == nullptr) throw bad_alloc();
+   return result;
+}
+
+void operator delete (void* pointer) noexcept {
+   free (pointer);
+}
+
+void operator delete (void* pointer, size_t) noexcept {
+   free (pointer);
+}
+
+bool profiler::enabled = false;
+
+void count_allocations() {
+   counting.store (true, memory_order_relaxed);
+}
+
+size_t allocation_count() {
+   return allocations.load (memory_order_relaxed);
+}
+
+void profiler::next (opcode op, size_t operand_bits) {
+   clock::time_point now = clock::now();
+   size_t allocs_now = allocation_count();
+   if (running) {
+      totals& last = table[static_cast<size_t> (current)];
+      clock::duration elapsed = now - started;
+      last.time += elapsed;
+      last.longest = max (last.longest, elapsed);
+      last.allocations += allocs_now - allocations_before;
+   }
+   totals& entry = table[static_cast<size_t> (op)];
+   ++entry.calls;
+   entry.bits += operand_bits;
+   entry.max_bits = max (entry.max_bits, operand_bits);
+   running = true;
+   current = op;
+   started = now;
+   allocations_before = allocs_now;
+}
+
+//
+// report -
+//    One line per opcode that has been run, with times in
+//    microseconds and operand sizes in decimal digits.  The time
+//    of end includes reading and compiling the next of the input.
+//
+void profiler::report (ostream& out) const {
+   using micros = chrono::duration<double, micro>;
+   auto digits = [] (double bits) {
+      return static_cast<size_t> (ceil (bits * log10 (2.0)));
+   };
+   out << left << setw (10) << "op" << right << setw (10) << "calls"
+       << setw (14) << "total us" << setw (12) << "max us"
+       << setw (12) << "avg digits" << setw (12) << "max digits"
+       << setw (12) << "allocs" << endl;
+   out << fixed << setprecision (1);
+   for (size_t index = 0; index < OPCODE_COUNT; ++index) {
+      const totals& entry = table[index];
+      if (entry.calls == 0) continue;
+      double avg_bits = static_cast<double> (entry.bits) / entry.calls;
+      out << left << setw (10) << static_cast<opcode> (index) << right
+          << setw (10) << entry.calls
+          << setw (14) << micros (entry.time).count()
+          << setw (12) << micros (entry.longest).count()
+          << setw (12) << digits (avg_bits)
+          << setw (12) << digits (entry.max_bits)
+          << setw (12) << entry.allocations << endl;
+   }
+   out << defaultfloat << setprecision (6);
+}
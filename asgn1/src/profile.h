@@ -0,0 +1,59 @@
+// $Id: profile.h,v 1.1 2026-10-17 12:00:00-07 - - $
+
+#ifndef __PROFILE_H__
+#define __PROFILE_H__
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+using namespace std;
+
+#include "bytecode.h"
+
+//
+// count_allocations -
+//    Starts counting the calls of operator new, which this module
+//    replaces.  Nothing is counted before, so that a program that
+//    is not being profiled does not pay for it.
+// allocation_count -
+//    The number of calls of operator new counted so far, from all
+//    threads.
+//
+void count_allocations();
+size_t allocation_count();
+
+//
+// profiler -
+//    Totals for each opcode of the number of times it was run,
+//    the time it took, the size of its operands and the
+//    allocations it made.  The interpreter calls next as it starts
+//    each instruction, which also closes off the one before, so
+//    that an instruction costs only one reading of the clock.
+//    The operand size is the longer of the top two numbers on the
+//    stack when the instruction starts.
+//
+class profiler {
+   private:
+      using clock = chrono::steady_clock;
+      struct totals {
+         size_t calls {0};
+         clock::duration time {};
+         clock::duration longest {};
+         size_t bits {0};
+         size_t max_bits {0};
+         size_t allocations {0};
+      };
+      array<totals, OPCODE_COUNT> table {};
+      bool running {false};
+      opcode current {opcode::END};
+      clock::time_point started;
+      size_t allocations_before {0};
+   public:
+      // Whether ydc runs its instructions through a profiler.
+      static bool enabled;
+      void next (opcode op, size_t operand_bits);
+      void report (ostream&) const;
+};
+
+#endif
@@ -1,32 +1,182 @@
-// $Id: scanner.cpp,v 1.21 2019-04-05 14:36:05-07 - - $
+// $Id: scanner.cpp,v 1.25 2026-10-17 12:00:00-07 - - $
 
 #include <cassert>
+#include <cerrno>
+#include <cstring>
 #include <iostream>
 #include <locale>
 #include <stdexcept>
+#include <system_error>
 #include <type_traits>
 #include <unordered_map>
 using namespace std;
 
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include "scanner.h"
 #include "debug.h"
 
-char scanner::get() {
-   if (not good()) throw runtime_error ("scanner::get() past EOF"); 
-   char currchar = nextchar;
-   nextchar = instream.get();
-   return currchar;
+static bool is_space (char chr) {
+   return isspace (static_cast<unsigned char> (chr));
+}
+
+static bool is_digit (char chr) {
+   return isdigit (static_cast<unsigned char> (chr));
+}
+
+scanner::scanner(): infd (STDIN_FILENO), buffer (BLOCK_SIZE) {
+   cursor = limit = buffer.data();
+}
+
+//
+// scanner (filename) -
+//    Maps a regular file whole.  Anything that can not be mapped,
+//    such as a pipe or an empty file, is read in blocks instead.
+//
+scanner::scanner (const char* filename):
+                  infd (open (filename, O_RDONLY)) {
+   if (infd < 0) throw system_error (errno, generic_category(),
+                                     filename);
+   struct stat status;
+   if (fstat (infd, &status) == 0 and S_ISREG (status.st_mode)
+       and status.st_size > 0) {
+      mapping_size = status.st_size;
+      mapping = mmap (nullptr, mapping_size, PROT_READ, MAP_PRIVATE,
+                      infd, 0);
+      if (mapping == MAP_FAILED) mapping = nullptr;
+   }
+   if (mapping != nullptr) {
+      madvise (mapping, mapping_size, MADV_SEQUENTIAL);
+      cursor = static_cast<const char*> (mapping);
+      limit = cursor + mapping_size;
+   }else {
+      buffer.resize (BLOCK_SIZE);
+      cursor = limit = buffer.data();
+   }
+}
+
+scanner::scanner (string_view text):
+                  infd (-1), cursor (text.data()),
+                  limit (text.data() + text.size()) {
+}
+
+scanner::~scanner() {
+   if (mapping != nullptr) munmap (mapping, mapping_size);
+   if (infd >= 0 and infd != STDIN_FILENO) close (infd);
+}
+
+//
+// refill -
+//    Reads another block after the unscanned input, first moving
+//    the partial token starting at keep to the front of the buffer
+//    so that a token is always contiguous.  The buffer doubles if
+//    that token already fills it.  Returns false at end of file,
+//    or once wakefd is readable, with keep and cursor still valid.
+//
+bool scanner::refill (const char*& keep) {
+   if (mapping != nullptr or infd < 0) return false;
+   size_t offset = keep - buffer.data();
+   size_t kept = limit - keep;
+   size_t scanned = cursor - keep;
+   if (kept == buffer.size()) buffer.resize (2 * buffer.size());
+   char* base = buffer.data();
+   memmove (base, base + offset, kept);
+   if (wakefd >= 0) {
+      pollfd fds[] {{infd, POLLIN, 0}, {wakefd, POLLIN, 0}};
+      int ready;
+      do {
+         ready = poll (fds, 2, -1);
+      }while (ready < 0 and errno == EINTR);
+      if (ready < 0) throw system_error (errno, generic_category(),
+                                         "poll");
+      if (fds[1].revents != 0) return false;
+   }
+   ssize_t count;
+   do {
+      count = read (infd, base + kept, buffer.size() - kept);
+   }while (count < 0 and errno == EINTR);
+   if (count < 0) throw system_error (errno, generic_category(),
+                                      "read");
+   keep = base;
+   cursor = base + scanned;
+   limit = base + kept + count;
+   return count > 0;
+}
+
+//
+// at_end -
+//    Skips white space and tells whether the input is exhausted.
+//
+bool scanner::at_end() {
+   for (;;) {
+      while (cursor < limit and is_space (*cursor)) ++cursor;
+      if (cursor < limit) return false;
+      const char* none = cursor;
+      if (not refill (none)) return true;
+   }
+}
+
+//
+// buffered -
+//    Skips white space and tells whether there is more input
+//    already read, without waiting for any.
+//
+bool scanner::buffered() {
+   while (cursor < limit and is_space (*cursor)) ++cursor;
+   return cursor < limit;
+}
+
+//
+// scan_string -
+//    Scans to the bracket matching the one at start.  Brackets
+//    nest.  A string still open at end of file runs to the end.
+//
+token scanner::scan_string (const char* start) {
+   size_t depth = 1;
+   for (;;) {
+      while (cursor < limit) {
+         char chr = *cursor++;
+         if (chr == '[') {
+            ++depth;
+         }else if (chr == ']' and --depth == 0) {
+            return {tsymbol::STRING,
+                    string_view (start + 1, cursor - start - 2)};
+         }
+      }
+      if (not refill (start)) {
+         return {tsymbol::STRING,
+                 string_view (start + 1, cursor - start - 1)};
+      }
+   }
+}
+
+static bool takes_register (char oper) {
+   return "sSlL<>="sv.find (oper) != string_view::npos;
 }
 
 token scanner::scan() {
-   while (good() and isspace (nextchar)) get();
-   if (not good()) return {tsymbol::SCANEOF};
-   if (nextchar == '_' or isdigit (nextchar)) {
-      token result {tsymbol::NUMBER, {get()}};
-      while (good() and isdigit (nextchar)) result.lexinfo += get();
-      return result;
+   if (at_end()) return {tsymbol::SCANEOF};
+   const char* start = cursor++;
+   if (*start == '[') return scan_string (start);
+   if (*start != '_' and *start != '.' and not is_digit (*start)) {
+      if (takes_register (*start)
+          and (cursor < limit or refill (start))) ++cursor;
+      return {tsymbol::OPERATOR, string_view (start, cursor - start)};
+   }
+   bool point = *start == '.';
+   for (;;) {
+      while (cursor < limit and (is_digit (*cursor)
+                                 or (*cursor == '.' and not point))) {
+         point = point or *cursor == '.';
+         ++cursor;
+      }
+      if (cursor < limit or not refill (start)) break;
    }
-   return {tsymbol::OPERATOR, {get()}};
+   return {tsymbol::NUMBER, string_view (start, cursor - start)};
 }
 
 ostream& operator<< (ostream& out, tsymbol symbol) {
@@ -37,6 +187,7 @@ ostream& operator<< (ostream& out, tsymbol symbol) {
    };
    static const unordered_map<tsymbol,string,hasher> map {
       {tsymbol::NUMBER  , "NUMBER"  },
+      {tsymbol::STRING  , "STRING"  },
       {tsymbol::OPERATOR, "OPERATOR"},
       {tsymbol::SCANEOF , "SCANEOF" },
    };
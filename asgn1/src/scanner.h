@@ -1,33 +1,72 @@
-// $Id: scanner.h,v 1.13 2019-04-01 18:13:04-07 - - $
+// $Id: scanner.h,v 1.17 2026-10-17 12:00:00-07 - - $
 
 #ifndef __SCANNER_H__
 #define __SCANNER_H__
 
 #include <iostream>
+#include <string>
+#include <string_view>
 #include <utility>
+#include <vector>
 using namespace std;
 
 #include "debug.h"
 
-enum class tsymbol {SCANEOF, NUMBER, OPERATOR};
+enum class tsymbol {SCANEOF, NUMBER, STRING, OPERATOR};
 
+//
+// token -
+//    The lexinfo is a view into the scanner's buffer, and is only
+//    valid until the next call to scan().  A NUMBER may have one
+//    decimal point.  A STRING's lexinfo is the text between its
+//    brackets.  The lexinfo of an OPERATOR that names a register
+//    (s l S L < > =) includes the register.
+//
 struct token {
    tsymbol symbol;
-   string lexinfo;
-   token (tsymbol sym, const string& lex = string()):
+   string_view lexinfo;
+   token (tsymbol sym, string_view lex = string_view()):
           symbol(sym), lexinfo(lex){
    }
 };
 
+//
+// scanner -
+//    Reads its input a block at a time with read(2), so that a
+//    terminal still delivers a line at a time but a pipe or file
+//    is taken in large chunks.  A named file is mapped into memory
+//    instead, and tokens then point straight into the mapping.
+//    A scanner over a string, used to run macros, works the same
+//    way.  Characters [cursor,limit) have not been scanned yet.
+//
+// interrupt_on -
+//    Makes a read wait as well on wakefd, and take anything
+//    arriving there as the end of the input, so that another thread
+//    can stop a scanner that is waiting for input.
+//
 class scanner {
    private:
-      istream& instream;
-      int nextchar {instream.get()};
-      bool good() { return nextchar != EOF; }
-      char get();
+      static constexpr size_t BLOCK_SIZE = 1 << 16;
+      int infd;
+      int wakefd {-1};
+      vector<char> buffer;
+      void* mapping {nullptr};
+      size_t mapping_size {0};
+      const char* cursor {nullptr};
+      const char* limit {nullptr};
+      bool refill (const char*& keep);
+      token scan_string (const char* start);
    public:
-      scanner (istream& instream_ = cin): instream(instream_) {}
+      scanner();
+      explicit scanner (const char* filename);
+      explicit scanner (string_view text);
+      scanner (const scanner&) = delete;
+      scanner& operator= (const scanner&) = delete;
+      ~scanner();
+      void interrupt_on (int wakefd_) { wakefd = wakefd_; }
       token scan();
+      bool at_end();
+      bool buffered();
 };
 
 ostream& operator<< (ostream&, tsymbol);
@@ -0,0 +1,145 @@
+// $Id: smallvec.h,v 1.1 2026-10-17 12:00:00-07 - - $
+
+//
+// smallvec -
+//    A vector of trivially copyable items that keeps up to
+//    inline_count of them inside the object itself and only goes
+//    to the heap when it grows past that.  Once on the heap it
+//    stays there, so that a value which shrinks and grows again
+//    does not reallocate.  Heap blocks come from block_pool, so
+//    capacities are powers of two bytes.
+//
+// Only the part of the std::vector interface that ubigint uses is
+// provided.  Iterators are plain pointers, and as with vector
+// they are invalidated by anything that may grow the storage.
+//
+
+#ifndef __SMALLVEC_H__
+#define __SMALLVEC_H__
+
+#include <algorithm>
+#include <cstddef>
+#include <initializer_list>
+#include <type_traits>
+#include <utility>
+using namespace std;
+
+#include "pool.h"
+
+template <typename item_t, size_t inline_count>
+class smallvec {
+   static_assert (is_trivially_copyable<item_t>::value,
+                  "smallvec items are moved with copy");
+   private:
+      size_t count {0};
+      size_t capacity_ {inline_count};
+      union {
+         item_t local[inline_count];
+         item_t* heap;
+      };
+      bool on_heap() const { return capacity_ > inline_count; }
+      void release() {
+         if (on_heap()) {
+            block_pool::deallocate (heap, capacity_ * sizeof (item_t));
+         }
+      }
+      void steal (smallvec& that) noexcept {
+         count = that.count;
+         capacity_ = that.capacity_;
+         if (that.on_heap()) heap = that.heap;
+                        else copy_n (that.local, count, local);
+         that.count = 0;
+         that.capacity_ = inline_count;
+      }
+   public:
+      using value_type = item_t;
+      using iterator = item_t*;
+      using const_iterator = const item_t*;
+
+      smallvec() {}
+      explicit smallvec (size_t size, item_t value = item_t()) {
+         assign (size, value);
+      }
+      smallvec (initializer_list<item_t> items) {
+         assign (items.begin(), items.end());
+      }
+      smallvec (const smallvec& that) {
+         assign (that.begin(), that.end());
+      }
+      smallvec (smallvec&& that) noexcept { steal (that); }
+      smallvec& operator= (const smallvec& that) {
+         if (this != &that) assign (that.begin(), that.end());
+         return *this;
+      }
+      smallvec& operator= (smallvec&& that) noexcept {
+         if (this != &that) { release(); steal (that); }
+         return *this;
+      }
+      ~smallvec() { release(); }
+
+      size_t size() const { return count; }
+      size_t capacity() const { return capacity_; }
+      bool empty() const { return count == 0; }
+      item_t* data() { return on_heap() ? heap : local; }
+      const item_t* data() const { return on_heap() ? heap : local; }
+      item_t* begin() { return data(); }
+      item_t* end() { return data() + count; }
+      const item_t* begin() const { return data(); }
+      const item_t* end() const { return data() + count; }
+      item_t& operator[] (size_t index) { return data()[index]; }
+      const item_t& operator[] (size_t index) const {
+         return data()[index];
+      }
+      item_t& back() { return data()[count - 1]; }
+      const item_t& back() const { return data()[count - 1]; }
+
+      void reserve (size_t wanted) {
+         if (wanted <= capacity_) return;
+         size_t bytes = max (wanted, 2 * capacity_) * sizeof (item_t);
+         item_t* items = static_cast<item_t*> (
+                         block_pool::allocate (bytes));
+         copy_n (data(), count, items);
+         release();
+         heap = items;
+         capacity_ = bytes / sizeof (item_t);
+      }
+      void resize (size_t size, item_t value = item_t()) {
+         reserve (size);
+         if (size > count) fill (end(), data() + size, value);
+         count = size;
+      }
+      void assign (size_t size, item_t value) {
+         count = 0;
+         reserve (size);
+         fill_n (data(), size, value);
+         count = size;
+      }
+      void assign (const item_t* first, const item_t* last) {
+         count = 0;
+         reserve (last - first);
+         copy (first, last, data());
+         count = last - first;
+      }
+      void push_back (item_t value) {
+         if (count == capacity_) reserve (count + 1);
+         data()[count++] = value;
+      }
+      void pop_back() { --count; }
+      void clear() { count = 0; }
+      item_t* erase (item_t* first, item_t* last) {
+         item_t* stop = copy (last, end(), first);
+         count = stop - begin();
+         return first;
+      }
+      void swap (smallvec& that) noexcept {
+         smallvec temp (move (that));
+         that = move (*this);
+         *this = move (temp);
+      }
+
+      bool operator== (const smallvec& that) const {
+         return equal (begin(), end(), that.begin(), that.end());
+      }
+};
+
+#endif
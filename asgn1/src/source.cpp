@@ -0,0 +1,101 @@
+// $Id: source.cpp,v 1.2 2026-10-17 12:00:00-07 - - $
+
+#include <cerrno>
+#include <system_error>
+#include <utility>
+using namespace std;
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "source.h"
+
+program_ptr inline_source::next() {
+   if (input->at_end()) return nullptr;
+   program_ptr code = compile (*input, true);
+   code->run_once = true;
+   return code;
+}
+
+pipelined_source::pipelined_source (shared_ptr<scanner> input):
+                  shared (make_shared<queue>()) {
+   if (pipe2 (wake, O_CLOEXEC) < 0) {
+      throw system_error (errno, generic_category(), "pipe");
+   }
+   input->interrupt_on (wake[0]);
+   shared->input = move (input);
+   reader = thread (read_ahead, shared);
+}
+
+pipelined_source::~pipelined_source() {
+   unique_lock<mutex> guard (shared->lock);
+   shared->stopping = true;
+   shared->changed.notify_all();
+   guard.unlock();
+   char byte = 0;
+   while (write (wake[1], &byte, 1) < 0 and errno == EINTR) continue;
+   reader.join();
+   close (wake[0]);
+   close (wake[1]);
+}
+
+//
+// read_ahead -
+//    The reading thread.  It waits while the queue is full, and
+//    stops at the end of the input, on a failure, or before the
+//    next piece once the source is being destroyed.
+//
+void pipelined_source::read_ahead (shared_ptr<queue> shared) {
+   for (;;) {
+      {
+         lock_guard<mutex> guard (shared->lock);
+         if (shared->stopping) {
+            shared->finished = true;
+            return;
+         }
+      }
+      program_ptr code;
+      try {
+         if (not shared->input->at_end()) {
+            code = compile (*shared->input, true, PIECE_SIZE);
+            code->run_once = true;
+         }
+      }catch (...) {
+         lock_guard<mutex> guard (shared->lock);
+         shared->failure = current_exception();
+      }
+      unique_lock<mutex> guard (shared->lock);
+      if (code == nullptr) {
+         shared->finished = true;
+         shared->changed.notify_all();
+         return;
+      }
+      shared->changed.wait (guard, [&] {
+         return shared->stopping
+             or shared->pieces.size() < QUEUE_DEPTH;
+      });
+      if (shared->stopping) {
+         shared->finished = true;
+         return;
+      }
+      shared->pieces.push_back (move (code));
+      shared->changed.notify_all();
+   }
+}
+
+program_ptr pipelined_source::next() {
+   unique_lock<mutex> guard (shared->lock);
+   shared->changed.wait (guard, [&] {
+      return not shared->pieces.empty() or shared->finished;
+   });
+   if (shared->pieces.empty()) {
+      if (shared->failure != nullptr) {
+         rethrow_exception (exchange (shared->failure, nullptr));
+      }
+      return nullptr;
+   }
+   program_ptr code = move (shared->pieces.front());
+   shared->pieces.pop_front();
+   shared->changed.notify_all();
+   return code;
+}
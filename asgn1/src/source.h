@@ -0,0 +1,75 @@
+// $Id: source.h,v 1.2 2026-10-17 12:00:00-07 - - $
+
+#ifndef __SOURCE_H__
+#define __SOURCE_H__
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+using namespace std;
+
+#include "bytecode.h"
+#include "scanner.h"
+
+//
+// inline_source -
+//    Compiles the input on the interpreter's own thread, as much
+//    of it as has already been read, so that a terminal is run a
+//    line at a time.
+//
+class inline_source: public program_source {
+   private:
+      shared_ptr<scanner> input;
+   public:
+      explicit inline_source (shared_ptr<scanner> input_):
+               input (move (input_)) {
+      }
+      program_ptr next() override;
+};
+
+//
+// pipelined_source -
+//    Reads and compiles the input on a thread of its own, in
+//    pieces of up to PIECE_SIZE instructions or as much as has
+//    been read, and hands them over through a queue of at most
+//    QUEUE_DEPTH pieces, so that scanning and parsing numbers
+//    overlap with running what came before.
+//    Failures on the reading thread are rethrown by next.
+//
+//    When ydc quits, the reading thread is told to stop and is
+//    joined, so that it is not still compiling while the program
+//    exits.  It stops before its next piece, and a read it is
+//    waiting on is woken through a pipe, which the scanner takes
+//    as the end of the input.
+//
+class pipelined_source: public program_source {
+   public:
+      static constexpr size_t PIECE_SIZE = 1 << 12;
+      static constexpr size_t QUEUE_DEPTH = 16;
+   private:
+      struct queue {
+         shared_ptr<scanner> input;
+         mutex lock;
+         condition_variable changed;
+         deque<program_ptr> pieces;
+         exception_ptr failure;
+         bool finished {false};
+         bool stopping {false};
+      };
+      shared_ptr<queue> shared;
+      int wake[2] {-1, -1};
+      thread reader;
+      static void read_ahead (shared_ptr<queue>);
+   public:
+      explicit pipelined_source (shared_ptr<scanner> input);
+      pipelined_source (const pipelined_source&) = delete;
+      pipelined_source& operator= (const pipelined_source&) = delete;
+      ~pipelined_source();
+      program_ptr next() override;
+};
+
+#endif
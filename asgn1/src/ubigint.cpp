@@ -1,211 +1,1571 @@
 // $Id: ubigint.cpp,v 1.16 2019-04-02 16:28:42-07 - - $
 
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cassert>
 #include <cctype>
 #include <cstdlib>
+#include <deque>
 #include <exception>
+#include <future>
+#include <iomanip>
+#include <mutex>
 #include <stack>
 #include <stdexcept>
 #include <string>
 #include <iostream>
+#include <thread>
 using namespace std;
 
+#if defined (__x86_64__) or defined (__i386__)
+#include <immintrin.h>
+#endif
+
 #include "ubigint.h"
 #include "debug.h"
+#include "pool.h"
+
+using udigit_t = ubigint::udigit_t;
+using udouble_t = ubigint::udouble_t;
+using ubigvalue_t = ubigint::ubigvalue_t;
+static constexpr int LIMB_BITS = ubigint::LIMB_BITS;
+
+size_t ubigint::karatsuba_threshold = 32;
+size_t ubigint::toom3_threshold = 300;
+size_t ubigint::ntt_threshold = 8000;
+size_t ubigint::bz_threshold = 60;
+size_t ubigint::parallel_threshold = 2000;
+size_t ubigint::thread_limit = max (thread::hardware_concurrency(), 1u);
+
+//
+// Decimal conversion works on chunks of DEC_CHUNK digits at a
+// time, DEC_RADIX being the largest power of 10 fitting in a limb.
+// See also Radix conversion below.
+//
+static constexpr int DEC_CHUNK = 9;
+static constexpr udigit_t DEC_RADIX = 1'000'000'000;
+
+//
+// mul_add_small -
+//    value = value * mult + add, for single limb mult and add.
+//
+static void mul_add_small (ubigvalue_t& value, udigit_t mult,
+                           udigit_t add) {
+   udouble_t carry = add;
+   for (auto& limb: value) {
+      carry += static_cast<udouble_t> (limb) * mult;
+      limb = static_cast<udigit_t> (carry);
+      carry >>= LIMB_BITS;
+   }
+   if (carry != 0) value.push_back (static_cast<udigit_t> (carry));
+}
+
+//
+// div_small -
+//    value = value / divisor, returning value % divisor.
+//
+static udigit_t div_small (ubigvalue_t& value, udigit_t divisor) {
+   udouble_t rem = 0;
+   for (size_t index = value.size(); index-- > 0; ) {
+      udouble_t cur = (rem << LIMB_BITS) | value[index];
+      value[index] = static_cast<udigit_t> (cur / divisor);
+      rem = cur % divisor;
+   }
+   while (not value.empty() and value.back() == 0) value.pop_back();
+   return static_cast<udigit_t> (rem);
+}
+
+//
+// Limb kernels -
+//    Operate on raw little-endian limb arrays given as pointer
+//    and size.  Output arrays are sized by the caller and may
+//    alias the left input where noted.
+//
+
+//
+// Vector kernels -
+//    add_n, sub_n and cmp_n work on equal length arrays.  With
+//    AVX2 they take eight limbs per step: the lanes are added or
+//    subtracted independently, and the carries between lanes are
+//    then resolved all at once from two bit masks, the lanes that
+//    generate a carry and the lanes that would propagate one
+//    (sum all ones, or difference zero).  Adding the propagate
+//    mask to the shifted generate mask ripples each carry through
+//    the run of propagating lanes above it, exactly as a carry
+//    lookahead adder does.  The scalar versions finish the last
+//    few limbs and serve when AVX2 is missing or turned off.
+//
+static udigit_t add_n_scalar (udigit_t* result, const udigit_t* left,
+                              const udigit_t* right, size_t size,
+                              udigit_t carry) {
+   udouble_t sum = carry;
+   for (size_t index = 0; index < size; ++index) {
+      sum += static_cast<udouble_t> (left[index]) + right[index];
+      result[index] = static_cast<udigit_t> (sum);
+      sum >>= LIMB_BITS;
+   }
+   return static_cast<udigit_t> (sum);
+}
+
+static udigit_t sub_n_scalar (udigit_t* result, const udigit_t* left,
+                              const udigit_t* right, size_t size,
+                              udigit_t borrow) {
+   for (size_t index = 0; index < size; ++index) {
+      udouble_t sub = static_cast<udouble_t> (right[index]) + borrow;
+      borrow = left[index] < sub ? 1 : 0;
+      result[index] = static_cast<udigit_t> (left[index] - sub);
+   }
+   return borrow;
+}
+
+static int cmp_n_scalar (const udigit_t* left, const udigit_t* right,
+                         size_t size) {
+   for (size_t index = size; index-- > 0; ) {
+      if (left[index] != right[index]) {
+         return left[index] < right[index] ? -1 : 1;
+      }
+   }
+   return 0;
+}
+
+#if defined (__x86_64__) or defined (__i386__)
+
+static constexpr size_t AVX2_LANES = 8;
+
+static bool have_avx2() {
+   __builtin_cpu_init();
+   return __builtin_cpu_supports ("avx2");
+}
+
+//
+// lane_carries -
+//    Given a carry into the lowest lane and the generate and
+//    propagate masks, returns the mask of lanes receiving a
+//    carry, with the carry out of the top lane in bit 8.
+//
+static unsigned lane_carries (unsigned carry, unsigned generate,
+                              unsigned propagate) {
+   unsigned ripple = (generate << 1 | carry) + propagate;
+   return ripple ^ propagate;
+}
+
+__attribute__ ((target ("avx2")))
+static __m256i lane_mask (unsigned bits) {
+   const __m256i lane_bits = _mm256_setr_epi32 (1, 2, 4, 8,
+                                                16, 32, 64, 128);
+   __m256i spread = _mm256_and_si256 (_mm256_set1_epi32 (bits),
+                                      lane_bits);
+   return _mm256_cmpeq_epi32 (spread, lane_bits);
+}
+
+__attribute__ ((target ("avx2")))
+static unsigned lane_bits (__m256i mask) {
+   return _mm256_movemask_ps (_mm256_castsi256_ps (mask));
+}
+
+__attribute__ ((target ("avx2")))
+static udigit_t add_n_vector (udigit_t* result, const udigit_t* left,
+                              const udigit_t* right, size_t size,
+                              udigit_t carry) {
+   // Unsigned comparison is signed comparison with the sign bits
+   // flipped.
+   const __m256i flip = _mm256_set1_epi32 (INT32_MIN);
+   const __m256i all_ones = _mm256_set1_epi32 (-1);
+   size_t index = 0;
+   for (; index + AVX2_LANES <= size; index += AVX2_LANES) {
+      __m256i lvec = _mm256_loadu_si256 (
+                     reinterpret_cast<const __m256i*> (left + index));
+      __m256i rvec = _mm256_loadu_si256 (
+                     reinterpret_cast<const __m256i*> (right + index));
+      __m256i sum = _mm256_add_epi32 (lvec, rvec);
+      unsigned generate = lane_bits (_mm256_cmpgt_epi32 (
+                          _mm256_xor_si256 (lvec, flip),
+                          _mm256_xor_si256 (sum, flip)));
+      unsigned propagate = lane_bits (_mm256_cmpeq_epi32 (sum,
+                                                          all_ones));
+      unsigned carries = lane_carries (carry, generate, propagate);
+      sum = _mm256_sub_epi32 (sum, lane_mask (carries));
+      _mm256_storeu_si256 (reinterpret_cast<__m256i*> (result + index),
+                           sum);
+      carry = carries >> AVX2_LANES;
+   }
+   return add_n_scalar (result + index, left + index, right + index,
+                        size - index, carry);
+}
+
+__attribute__ ((target ("avx2")))
+static udigit_t sub_n_vector (udigit_t* result, const udigit_t* left,
+                              const udigit_t* right, size_t size,
+                              udigit_t borrow) {
+   const __m256i flip = _mm256_set1_epi32 (INT32_MIN);
+   const __m256i zero = _mm256_setzero_si256();
+   size_t index = 0;
+   for (; index + AVX2_LANES <= size; index += AVX2_LANES) {
+      __m256i lvec = _mm256_loadu_si256 (
+                     reinterpret_cast<const __m256i*> (left + index));
+      __m256i rvec = _mm256_loadu_si256 (
+                     reinterpret_cast<const __m256i*> (right + index));
+      __m256i diff = _mm256_sub_epi32 (lvec, rvec);
+      unsigned generate = lane_bits (_mm256_cmpgt_epi32 (
+                          _mm256_xor_si256 (rvec, flip),
+                          _mm256_xor_si256 (lvec, flip)));
+      unsigned propagate = lane_bits (_mm256_cmpeq_epi32 (diff, zero));
+      unsigned borrows = lane_carries (borrow, generate, propagate);
+      diff = _mm256_add_epi32 (diff, lane_mask (borrows));
+      _mm256_storeu_si256 (reinterpret_cast<__m256i*> (result + index),
+                           diff);
+      borrow = borrows >> AVX2_LANES;
+   }
+   return sub_n_scalar (result + index, left + index, right + index,
+                        size - index, borrow);
+}
+
+__attribute__ ((target ("avx2")))
+static int cmp_n_vector (const udigit_t* left, const udigit_t* right,
+                         size_t size) {
+   size_t index = size;
+   for (; index >= AVX2_LANES; index -= AVX2_LANES) {
+      const udigit_t* lblock = left + index - AVX2_LANES;
+      const udigit_t* rblock = right + index - AVX2_LANES;
+      __m256i lvec = _mm256_loadu_si256 (
+                     reinterpret_cast<const __m256i*> (lblock));
+      __m256i rvec = _mm256_loadu_si256 (
+                     reinterpret_cast<const __m256i*> (rblock));
+      unsigned differ = ~lane_bits (_mm256_cmpeq_epi32 (lvec, rvec))
+                      & 0xFF;
+      if (differ != 0) {
+         size_t lane = bit_width (differ) - 1;
+         return lblock[lane] < rblock[lane] ? -1 : 1;
+      }
+   }
+   return cmp_n_scalar (left, right, index);
+}
+
+#else
+
+static bool have_avx2() {
+   return false;
+}
+
+static udigit_t add_n_vector (udigit_t* result, const udigit_t* left,
+                              const udigit_t* right, size_t size,
+                              udigit_t carry) {
+   return add_n_scalar (result, left, right, size, carry);
+}
+
+static udigit_t sub_n_vector (udigit_t* result, const udigit_t* left,
+                              const udigit_t* right, size_t size,
+                              udigit_t borrow) {
+   return sub_n_scalar (result, left, right, size, borrow);
+}
+
+static int cmp_n_vector (const udigit_t* left, const udigit_t* right,
+                         size_t size) {
+   return cmp_n_scalar (left, right, size);
+}
+
+#endif
+
+bool ubigint::vector_kernels = have_avx2();
+
+//
+// add_limbs -
+//    result[0..lsize) = left + right, lsize >= rsize.  Returns
+//    the carry out of the top limb.  result may alias left.
+//
+static udigit_t add_limbs (udigit_t* result,
+                           const udigit_t* left, size_t lsize,
+                           const udigit_t* right, size_t rsize) {
+   udigit_t carry = ubigint::vector_kernels
+                  ? add_n_vector (result, left, right, rsize, 0)
+                  : add_n_scalar (result, left, right, rsize, 0);
+   size_t index = rsize;
+   for (; carry != 0 and index < lsize; ++index) {
+      result[index] = left[index] + 1;
+      carry = result[index] == 0;
+   }
+   if (result != left) copy (left + index, left + lsize, result + index);
+   return carry;
+}
+
+//
+// sub_limbs -
+//    result[0..lsize) = left - right, lsize >= rsize.  Returns
+//    the borrow out of the top limb.  result may alias left.
+//
+static udigit_t sub_limbs (udigit_t* result,
+                           const udigit_t* left, size_t lsize,
+                           const udigit_t* right, size_t rsize) {
+   udigit_t borrow = ubigint::vector_kernels
+                   ? sub_n_vector (result, left, right, rsize, 0)
+                   : sub_n_scalar (result, left, right, rsize, 0);
+   size_t index = rsize;
+   for (; borrow != 0 and index < lsize; ++index) {
+      borrow = left[index] == 0;
+      result[index] = left[index] - 1;
+   }
+   if (result != left) copy (left + index, left + lsize, result + index);
+   return borrow;
+}
+
+//
+// cmp_limbs -
+//    Three way comparison of two normalized limb arrays.
+//
+static int cmp_limbs (const udigit_t* left, size_t lsize,
+                      const udigit_t* right, size_t rsize) {
+   if (lsize != rsize) return lsize < rsize ? -1 : 1;
+   return ubigint::vector_kernels ? cmp_n_vector (left, right, lsize)
+                                  : cmp_n_scalar (left, right, lsize);
+}
+
+//
+// add_into -
+//    result[offset..) += addend, propagating the carry up to
+//    result[size).  The caller guarantees that it does not
+//    carry out of the top.
+//
+static void add_into (udigit_t* result, size_t size, size_t offset,
+                      const udigit_t* addend, size_t asize) {
+   while (asize > 0 and addend[asize - 1] == 0) --asize;
+   assert (offset + asize <= size);
+   udigit_t carry = add_limbs (result + offset, result + offset,
+                               size - offset, addend, asize);
+   assert (carry == 0);
+   (void) carry;
+}
+
+static size_t trimmed (const udigit_t* value, size_t size) {
+   while (size > 0 and value[size - 1] == 0) --size;
+   return size;
+}
+
+static void mul_limbs (udigit_t* result,
+                       const udigit_t* left, size_t lsize,
+                       const udigit_t* right, size_t rsize);
+
+//
+// mul_basecase -
+//    Schoolbook multiplication, accumulated directly into
+//    result[0..lsize+rsize) one row per limb of right.
+//
+static void mul_basecase (udigit_t* result,
+                          const udigit_t* left, size_t lsize,
+                          const udigit_t* right, size_t rsize) {
+   fill (result, result + lsize + rsize, 0);
+   for (size_t row = 0; row < rsize; ++row) {
+      udouble_t mult = right[row];
+      if (mult == 0) continue;
+      udouble_t carry = 0;
+      udigit_t* dest = result + row;
+      for (size_t col = 0; col < lsize; ++col) {
+         carry += left[col] * mult + dest[col];
+         dest[col] = static_cast<udigit_t> (carry);
+         carry >>= LIMB_BITS;
+      }
+      dest[lsize] = static_cast<udigit_t> (carry);
+   }
+}
+
+//
+// mul_unbalanced -
+//    When left is at least twice as long as right, multiply
+//    right by successive right-sized slices of left so that
+//    each partial product is balanced.
+//
+static void mul_unbalanced (udigit_t* result,
+                            const udigit_t* left, size_t lsize,
+                            const udigit_t* right, size_t rsize) {
+   size_t size = lsize + rsize;
+   fill (result, result + size, 0);
+   ubigvalue_t partial (2 * rsize);
+   for (size_t offset = 0; offset < lsize; offset += rsize) {
+      size_t slice = min (rsize, lsize - offset);
+      mul_limbs (partial.data(), left + offset, slice, right, rsize);
+      add_into (result, size, offset, partial.data(), slice + rsize);
+   }
+}
+
+//
+// Parallel multiplication -
+//    Independent sub-products, and the passes of a large NTT, are
+//    handed to helper threads.  At most thread_limit - 1 helpers
+//    run at once over all levels of recursion; when none is free
+//    the work is done on the calling thread instead, so the lower
+//    levels of a recursion that has used up the helpers run
+//    serially with no further cost.
+//
+static atomic<size_t> helpers_busy {0};
+
+static bool claim_helper() {
+   size_t busy = helpers_busy.load();
+   while (busy + 1 < ubigint::thread_limit) {
+      if (helpers_busy.compare_exchange_weak (busy, busy + 1)) {
+         return true;
+      }
+   }
+   return false;
+}
+
+//
+// run_tasks -
+//    Calls task(nr) for each nr in [0,count), giving each task but
+//    the last to a helper if one can be claimed, and returns when
+//    all are done.  An exception thrown by a helper is rethrown.
+//
+template <typename task_t>
+static void run_tasks (size_t count, const task_t& task) {
+   vector<future<void>> helpers;
+   for (size_t nr = 0; nr + 1 < count; ++nr) {
+      if (not claim_helper()) {
+         task (nr);
+         continue;
+      }
+      helpers.push_back (async (launch::async, [&task, nr]() {
+         struct release {
+            ~release() { helpers_busy.fetch_sub (1); }
+         } releaser;
+         task (nr);
+      }));
+   }
+   if (count > 0) task (count - 1);
+   for (auto& helper: helpers) helper.get();
+}
+
+//
+// parallel_for -
+//    Calls body(begin, end) over consecutive slices of [0,count),
+//    one slice per thread that might help, but none smaller than
+//    grain.
+//
+template <typename body_t>
+static void parallel_for (size_t count, size_t grain,
+                          const body_t& body) {
+   size_t slices = min (ubigint::thread_limit,
+                        max<size_t> (count / grain, 1));
+   run_tasks (slices, [&] (size_t slice) {
+      body (count * slice / slices, count * (slice + 1) / slices);
+   });
+}
+
+//
+// mul_karatsuba -
+//    Split both operands at half = ceil(lsize/2) limbs:
+//       left = l1 * B^half + l0, right = r1 * B^half + r0
+//    Then left*right = z2 * B^2half + z1 * B^half + z0, where
+//    z0 = l0*r0, z2 = l1*r1 and z1 = (l0+l1)(r0+r1) - z0 - z2.
+//    Requires half <= rsize <= lsize.
+//
+static void mul_karatsuba (udigit_t* result,
+                           const udigit_t* left, size_t lsize,
+                           const udigit_t* right, size_t rsize) {
+   size_t half = (lsize + 1) / 2;
+   size_t lhigh = lsize - half;
+   size_t rhigh = rsize - half;
+   size_t size = lsize + rsize;
+   ubigvalue_t lsum (half + 1);
+   ubigvalue_t rsum (half + 1);
+   lsum[half] = add_limbs (lsum.data(), left, half, left + half, lhigh);
+   rsum[half] = add_limbs (rsum.data(), right, half,
+                           right + half, rhigh);
+   ubigvalue_t middle (2 * half + 2);
+   auto product = [&] (size_t which) {
+      switch (which) {
+         case 0: mul_limbs (result, left, half, right, half);
+                 break;
+         case 1: mul_limbs (result + 2 * half, left + half, lhigh,
+                            right + half, rhigh);
+                 break;
+         case 2: mul_limbs (middle.data(), lsum.data(), half + 1,
+                            rsum.data(), half + 1);
+                 break;
+      }
+   };
+   if (rsize >= ubigint::parallel_threshold) {
+      run_tasks (3, product);
+   }else {
+      for (size_t which = 0; which < 3; ++which) product (which);
+   }
+   sub_limbs (middle.data(), middle.data(), middle.size(),
+              result, 2 * half);
+   sub_limbs (middle.data(), middle.data(), middle.size(),
+              result + 2 * half, size - 2 * half);
+   add_into (result, size, half, middle.data(), middle.size());
+}
+
+//
+// Toom-3 works with signed intermediate values, kept here as
+// a normalized magnitude and a sign.  These helpers are only
+// used at the top of each Toom-3 level, so they use vectors.
+//
+struct signed_limbs {
+   ubigvalue_t mag;
+   bool is_negative {false};
+};
+
+static signed_limbs slice_limbs (const udigit_t* value, size_t size,
+                                 size_t begin, size_t end) {
+   begin = min (begin, size);
+   end = min (end, size);
+   signed_limbs result;
+   result.mag.assign (value + begin, value + end);
+   result.mag.resize (trimmed (result.mag.data(), result.mag.size()));
+   return result;
+}
+
+static ubigvalue_t add_mag (const ubigvalue_t& left,
+                            const ubigvalue_t& right) {
+   const ubigvalue_t& big = left.size() >= right.size() ? left : right;
+   const ubigvalue_t& small = &big == &left ? right : left;
+   ubigvalue_t result (big.size() + 1);
+   result[big.size()] = add_limbs (result.data(), big.data(),
+                                   big.size(), small.data(),
+                                   small.size());
+   result.resize (trimmed (result.data(), result.size()));
+   return result;
+}
+
+static ubigvalue_t sub_mag (const ubigvalue_t& left,
+                            const ubigvalue_t& right) {
+   ubigvalue_t result (left.size());
+   sub_limbs (result.data(), left.data(), left.size(),
+              right.data(), right.size());
+   result.resize (trimmed (result.data(), result.size()));
+   return result;
+}
+
+static signed_limbs operator+ (const signed_limbs& left,
+                               const signed_limbs& right) {
+   signed_limbs result;
+   if (left.is_negative == right.is_negative) {
+      result.mag = add_mag (left.mag, right.mag);
+      result.is_negative = left.is_negative;
+   }else if (cmp_limbs (left.mag.data(), left.mag.size(),
+                        right.mag.data(), right.mag.size()) >= 0) {
+      result.mag = sub_mag (left.mag, right.mag);
+      result.is_negative = left.is_negative;
+   }else {
+      result.mag = sub_mag (right.mag, left.mag);
+      result.is_negative = right.is_negative;
+   }
+   if (result.mag.empty()) result.is_negative = false;
+   return result;
+}
+
+static signed_limbs operator- (const signed_limbs& left,
+                               const signed_limbs& right) {
+   signed_limbs negated {right.mag, not right.is_negative};
+   return left + negated;
+}
+
+static signed_limbs operator* (const signed_limbs& left,
+                               const signed_limbs& right) {
+   signed_limbs result;
+   if (left.mag.empty() or right.mag.empty()) return result;
+   result.mag.resize (left.mag.size() + right.mag.size());
+   mul_limbs (result.mag.data(), left.mag.data(), left.mag.size(),
+              right.mag.data(), right.mag.size());
+   result.mag.resize (trimmed (result.mag.data(), result.mag.size()));
+   result.is_negative = left.is_negative != right.is_negative;
+   return result;
+}
+
+static signed_limbs shift_left_1 (signed_limbs value) {
+   mul_add_small (value.mag, 2, 0);
+   return value;
+}
+
+//
+// div_exact -
+//    Divides by a small divisor which is known to divide exactly.
+//
+static signed_limbs div_exact (signed_limbs value, udigit_t divisor) {
+   udigit_t rem = div_small (value.mag, divisor);
+   assert (rem == 0);
+   (void) rem;
+   return value;
+}
+
+//
+// mul_toom3 -
+//    Split both operands into three pieces of third limbs and
+//    evaluate at 0, 1, -1, -2 and infinity, then interpolate
+//    using Bodrato's sequence.  Requires 2*third < rsize.
+//
+static void mul_toom3 (udigit_t* result,
+                       const udigit_t* left, size_t lsize,
+                       const udigit_t* right, size_t rsize) {
+   size_t third = (lsize + 2) / 3;
+   signed_limbs left0 = slice_limbs (left, lsize, 0, third);
+   signed_limbs left1 = slice_limbs (left, lsize, third, 2 * third);
+   signed_limbs left2 = slice_limbs (left, lsize, 2 * third, lsize);
+   signed_limbs right0 = slice_limbs (right, rsize, 0, third);
+   signed_limbs right1 = slice_limbs (right, rsize, third, 2 * third);
+   signed_limbs right2 = slice_limbs (right, rsize, 2 * third, rsize);
+
+   signed_limbs ltmp = left0 + left2;
+   signed_limbs rtmp = right0 + right2;
+   signed_limbs lone = ltmp + left1;
+   signed_limbs rone = rtmp + right1;
+   signed_limbs lneg1 = ltmp - left1;
+   signed_limbs rneg1 = rtmp - right1;
+   signed_limbs lneg2 = shift_left_1 (lneg1 + left2) - left0;
+   signed_limbs rneg2 = shift_left_1 (rneg1 + right2) - right0;
+
+   signed_limbs val0, val1, valneg1, valneg2, valinf;
+   struct { signed_limbs* val; const signed_limbs& left;
+            const signed_limbs& right; } products[] {
+      {&val0, left0, right0}, {&val1, lone, rone},
+      {&valneg1, lneg1, rneg1}, {&valneg2, lneg2, rneg2},
+      {&valinf, left2, right2},
+   };
+   auto product = [&] (size_t which) {
+      *products[which].val = products[which].left
+                           * products[which].right;
+   };
+   if (rsize >= ubigint::parallel_threshold) {
+      run_tasks (size (products), product);
+   }else {
+      for (size_t which = 0; which < size (products); ++which) {
+         product (which);
+      }
+   }
+
+   signed_limbs coef3 = div_exact (valneg2 - val1, 3);
+   signed_limbs coef1 = div_exact (val1 - valneg1, 2);
+   signed_limbs coef2 = valneg1 - val0;
+   coef3 = div_exact (coef2 - coef3, 2) + shift_left_1 (valinf);
+   coef2 = coef2 + coef1 - valinf;
+   coef1 = coef1 - coef3;
+
+   size_t size = lsize + rsize;
+   fill (result, result + size, 0);
+   const signed_limbs* coefs[] {&val0, &coef1, &coef2, &coef3,
+                                &valinf};
+   for (size_t power = 0; power < 5; ++power) {
+      const signed_limbs& coef = *coefs[power];
+      assert (not coef.is_negative);
+      add_into (result, size, power * third,
+                coef.mag.data(), coef.mag.size());
+   }
+}
+
+//
+// NTT multiplication -
+//    The operands are cut into 16-bit pieces and convolved
+//    modulo each of three NTT primes, then the exact convolution
+//    is recovered by the Chinese remainder theorem.  Each
+//    coefficient of the convolution is below length * 2^32, far
+//    under the product of the primes (about 2^86), so no
+//    rounding or overflow is possible.  All three primes have 3
+//    as a primitive root and support transforms up to 2^23.
+//
+struct ntt_prime {
+   udigit_t modulus;
+   udigit_t root;
+};
+static constexpr ntt_prime NTT_PRIMES[] {
+   {998244353, 3}, {167772161, 3}, {469762049, 3},
+};
+static constexpr int NTT_PIECE_BITS = 16;
+static constexpr udigit_t NTT_PIECE_MASK = (1u << NTT_PIECE_BITS) - 1;
+static constexpr size_t NTT_MAX_LENGTH = size_t {1} << 23;
+using ntt_vector = vector<udigit_t, pool_allocator<udigit_t>>;
+
+static udigit_t mul_mod (udigit_t left, udigit_t right,
+                         udigit_t modulus) {
+   return static_cast<udigit_t> (static_cast<udouble_t> (left) * right
+                                 % modulus);
+}
+
+//
+// mul_shoup -
+//    left * right % modulus for a fixed right operand, using the
+//    precomputed quotient right_shoup = right * 2^32 / modulus
+//    in place of a division.  Requires modulus < 2^31.
+//
+static udigit_t mul_shoup (udigit_t left, udigit_t right,
+                           udigit_t right_shoup, udigit_t modulus) {
+   udigit_t quotient = static_cast<udigit_t> (
+         static_cast<udouble_t> (left) * right_shoup >> LIMB_BITS);
+   udigit_t rem = left * right - quotient * modulus;
+   return rem >= modulus ? rem - modulus : rem;
+}
+
+static udigit_t shoup_of (udigit_t value, udigit_t modulus) {
+   return static_cast<udigit_t> ((static_cast<udouble_t> (value)
+                                  << LIMB_BITS) / modulus);
+}
+
+static udigit_t pow_mod (udigit_t base, udouble_t exponent,
+                         udigit_t modulus) {
+   udigit_t result = 1;
+   for (; exponent > 0; exponent >>= 1) {
+      if (exponent & 1) result = mul_mod (result, base, modulus);
+      base = mul_mod (base, base, modulus);
+   }
+   return result;
+}
+
+//
+// ntt_roots -
+//    Twiddle factors and their Shoup quotients for one prime and
+//    direction, by level: level k holds the 2^k powers of the
+//    primitive 2^(k+1)th root of unity used by the butterflies
+//    spanning 2^k.  Levels are built on demand under a lock and
+//    never change after, so transforms in any thread may use them.
+//
+struct ntt_level {
+   vector<udigit_t> roots;
+   vector<udigit_t> shoups;
+};
+static constexpr size_t NTT_LEVELS = countr_zero (NTT_MAX_LENGTH);
+
+static const ntt_level* ntt_roots (size_t prime_nr, bool inverse,
+                                   size_t length) {
+   static mutex lock;
+   static ntt_level tables[size (NTT_PRIMES)][2][NTT_LEVELS];
+   lock_guard<mutex> guard (lock);
+   ntt_level* levels = tables[prime_nr][inverse];
+   const ntt_prime& prime = NTT_PRIMES[prime_nr];
+   udigit_t modulus = prime.modulus;
+   for (size_t level = 0; size_t {1} << level < length; ++level) {
+      ntt_level& entry = levels[level];
+      if (not entry.roots.empty()) continue;
+      size_t half = size_t {1} << level;
+      udigit_t step = pow_mod (prime.root, (modulus - 1) / (2 * half),
+                               modulus);
+      if (inverse) step = pow_mod (step, modulus - 2, modulus);
+      entry.roots.resize (half);
+      entry.shoups.resize (half);
+      udigit_t power = 1;
+      for (size_t index = 0; index < half; ++index) {
+         entry.roots[index] = power;
+         entry.shoups[index] = shoup_of (power, modulus);
+         power = mul_mod (power, step, modulus);
+      }
+   }
+   return levels;
+}
+
+//
+// ntt_stage -
+//    Applies butterfly (low, high, index) to every pair of the
+//    stage whose butterflies span half, with the length / 2 pairs
+//    numbered block by block and shared out between threads.
+//
+static constexpr size_t NTT_GRAIN = size_t {1} << 15;
+
+template <typename butterfly_t>
+static void ntt_stage (udigit_t* data, size_t length, size_t half,
+                       const butterfly_t& butterfly) {
+   parallel_for (length / 2, NTT_GRAIN,
+                 [&] (size_t first, size_t last) {
+      udigit_t* low = data + 2 * (first - first % half);
+      size_t index = first % half;
+      for (size_t left = last - first; left > 0; low += 2 * half) {
+         size_t stop = min (half, index + left);
+         left -= stop - index;
+         for (; index < stop; ++index) {
+            butterfly (low[index], low[index + half], index);
+         }
+         index = 0;
+      }
+   });
+}
+
+//
+// ntt_transform -
+//    In place radix-2 transform of a power of 2 length.  The
+//    forward transform is decimation in frequency, taking natural
+//    order to bit-reversed order, and the inverse is decimation in
+//    time, taking it back, so no bit reversal pass is needed.
+//    The inverse transform includes the division by the length.
+//
+static void ntt_transform (ntt_vector& data, bool inverse,
+                           size_t prime_nr) {
+   udigit_t modulus = NTT_PRIMES[prime_nr].modulus;
+   size_t length = data.size();
+   const ntt_level* levels = ntt_roots (prime_nr, inverse, length);
+   if (inverse) {
+      for (size_t half = 1; half < length; half <<= 1) {
+         const ntt_level& level = levels[countr_zero (half)];
+         const udigit_t* roots = level.roots.data();
+         const udigit_t* shoups = level.shoups.data();
+         ntt_stage (data.data(), length, half,
+                    [=] (udigit_t& low, udigit_t& high,
+                         size_t index) {
+            udigit_t even = low;
+            udigit_t odd = mul_shoup (high, roots[index],
+                                      shoups[index], modulus);
+            udigit_t sum = even + odd;
+            low = sum >= modulus ? sum - modulus : sum;
+            high = even + (modulus - odd);
+            if (high >= modulus) high -= modulus;
+         });
+      }
+      udigit_t scale = pow_mod (static_cast<udigit_t> (length),
+                                modulus - 2, modulus);
+      udigit_t scale_shoup = shoup_of (scale, modulus);
+      parallel_for (length, NTT_GRAIN, [&] (size_t first, size_t last) {
+         for (size_t index = first; index < last; ++index) {
+            data[index] = mul_shoup (data[index], scale, scale_shoup,
+                                     modulus);
+         }
+      });
+   }else {
+      for (size_t half = length / 2; half >= 1; half >>= 1) {
+         const ntt_level& level = levels[countr_zero (half)];
+         const udigit_t* roots = level.roots.data();
+         const udigit_t* shoups = level.shoups.data();
+         ntt_stage (data.data(), length, half,
+                    [=] (udigit_t& low, udigit_t& high,
+                         size_t index) {
+            udigit_t even = low;
+            udigit_t odd = high;
+            udigit_t sum = even + odd;
+            low = sum >= modulus ? sum - modulus : sum;
+            high = mul_shoup (even + (modulus - odd), roots[index],
+                              shoups[index], modulus);
+         });
+      }
+   }
+}
+
+static void ntt_load (ntt_vector& data, const udigit_t* value,
+                      size_t size) {
+   fill (data.begin() + 2 * size, data.end(), 0);
+   parallel_for (size, NTT_GRAIN, [&] (size_t first, size_t last) {
+      for (size_t index = first; index < last; ++index) {
+         data[2 * index] = value[index] & NTT_PIECE_MASK;
+         data[2 * index + 1] = value[index] >> NTT_PIECE_BITS;
+      }
+   });
+}
+
+//
+// ntt_convolve -
+//    Cyclic convolution of left and right modulo one prime,
+//    returned in natural order.  Squaring skips a transform.
+//
+static ntt_vector ntt_convolve (const udigit_t* left, size_t lsize,
+                                const udigit_t* right, size_t rsize,
+                                size_t length, size_t prime_nr) {
+   udigit_t modulus = NTT_PRIMES[prime_nr].modulus;
+   bool squaring = left == right and lsize == rsize;
+   ntt_vector ltrans (length);
+   ntt_vector rtrans (squaring ? 0 : length);
+   run_tasks (squaring ? 1 : 2, [&] (size_t which) {
+      ntt_vector& trans = which == 0 ? ltrans : rtrans;
+      if (which == 0) ntt_load (trans, left, lsize);
+                 else ntt_load (trans, right, rsize);
+      ntt_transform (trans, false, prime_nr);
+   });
+   const ntt_vector& other = squaring ? ltrans : rtrans;
+   parallel_for (length, NTT_GRAIN, [&] (size_t first, size_t last) {
+      for (size_t index = first; index < last; ++index) {
+         ltrans[index] = mul_mod (ltrans[index], other[index],
+                                  modulus);
+      }
+   });
+   ntt_transform (ltrans, true, prime_nr);
+   return ltrans;
+}
+
+//
+// add_wide -
+//    Adds a 64-bit addend at limb position offset into a small
+//    multi-limb accumulator.
+//
+static void add_wide (udigit_t* accum, size_t size, size_t offset,
+                      udouble_t addend) {
+   for (size_t index = offset; index < size and addend != 0;
+        ++index) {
+      addend += accum[index];
+      accum[index] = static_cast<udigit_t> (addend);
+      addend >>= LIMB_BITS;
+   }
+}
+
+static size_t ntt_length (size_t lsize, size_t rsize) {
+   size_t pieces = (lsize + rsize) * (LIMB_BITS / NTT_PIECE_BITS);
+   size_t length = 1;
+   while (length < pieces) length <<= 1;
+   return length;
+}
+
+static void mul_ntt (udigit_t* result,
+                     const udigit_t* left, size_t lsize,
+                     const udigit_t* right, size_t rsize) {
+   size_t length = ntt_length (lsize, rsize);
+   ntt_vector residues[size (NTT_PRIMES)];
+   run_tasks (size (NTT_PRIMES), [&] (size_t prime_nr) {
+      residues[prime_nr] = ntt_convolve (left, lsize, right, rsize,
+                                         length, prime_nr);
+   });
+   // Garner's algorithm:
+   //    x = r0 + p0 * (t1 + p1 * t2)
+   // where t1 and t2 are digits in the mixed radix p0, p1.
+   const udigit_t prime0 = NTT_PRIMES[0].modulus;
+   const udigit_t prime1 = NTT_PRIMES[1].modulus;
+   const udigit_t prime2 = NTT_PRIMES[2].modulus;
+   const udouble_t prime01 = static_cast<udouble_t> (prime0) * prime1;
+   const udigit_t inv0mod1 = pow_mod (prime0 % prime1, prime1 - 2,
+                                      prime1);
+   const udigit_t inv01mod2 = pow_mod (prime01 % prime2, prime2 - 2,
+                                       prime2);
+   udigit_t accum[4] {};
+   size_t pieces = 2 * (lsize + rsize);
+   for (size_t index = 0; index < pieces; ++index) {
+      udigit_t res0 = residues[0][index];
+      udigit_t res1 = residues[1][index];
+      udigit_t res2 = residues[2][index];
+      udigit_t diff1 = (res1 + prime1 - res0 % prime1) % prime1;
+      udigit_t digit1 = mul_mod (diff1, inv0mod1, prime1);
+      udouble_t low = res0 + static_cast<udouble_t> (prime0) * digit1;
+      udigit_t diff2 = (res2 + prime2 - low % prime2) % prime2;
+      udigit_t digit2 = mul_mod (diff2, inv01mod2, prime2);
+      add_wide (accum, 4, 0, low);
+      add_wide (accum, 4, 0, (prime01 & ~udigit_t {0}) * digit2);
+      add_wide (accum, 4, 1, (prime01 >> LIMB_BITS) * digit2);
+      udigit_t piece = accum[0] & NTT_PIECE_MASK;
+      if (index % 2 == 0) result[index / 2] = piece;
+                     else result[index / 2] |= piece << NTT_PIECE_BITS;
+      for (size_t limb = 0; limb < 4; ++limb) {
+         accum[limb] = (accum[limb] >> NTT_PIECE_BITS)
+                     | (limb + 1 < 4 ? accum[limb + 1]
+                                       << NTT_PIECE_BITS : 0);
+      }
+   }
+   assert (accum[0] == 0 and accum[1] == 0);
+}
+
+//
+// mul_limbs -
+//    result[0..lsize+rsize) = left * right, dispatching on the
+//    size of the shorter operand.  result must not alias either
+//    input.  Karatsuba needs at least 4 limbs to make progress,
+//    whatever the tunable threshold says.  Products too long for
+//    one NTT are split up by the other algorithms until they fit.
+//
+static void mul_limbs (udigit_t* result,
+                       const udigit_t* left, size_t lsize,
+                       const udigit_t* right, size_t rsize) {
+   if (lsize < rsize) {
+      swap (left, right);
+      swap (lsize, rsize);
+   }
+   if (rsize < max<size_t> (ubigint::karatsuba_threshold, 4)) {
+      mul_basecase (result, left, lsize, right, rsize);
+   }else if (rsize >= ubigint::ntt_threshold
+             and ntt_length (lsize, rsize) <= NTT_MAX_LENGTH) {
+      mul_ntt (result, left, lsize, right, rsize);
+   }else if (2 * rsize <= lsize) {
+      mul_unbalanced (result, left, lsize, right, rsize);
+   }else if (rsize >= ubigint::toom3_threshold
+             and 2 * ((lsize + 2) / 3) < rsize) {
+      mul_toom3 (result, left, lsize, right, rsize);
+   }else {
+      mul_karatsuba (result, left, lsize, right, rsize);
+   }
+}
+
+//
+// Division -
+//    divmod_limbs is the single entry point, producing quotient
+//    and remainder together.  Small divisors use Knuth's
+//    Algorithm D; when both the divisor and the quotient are long,
+//    Burnikel-Ziegler recursion reduces the problem to
+//    multiplications plus Algorithm D on short pieces.
+//
+
+static void trim (ubigvalue_t& value) {
+   value.resize (trimmed (value.data(), value.size()));
+}
+
+static size_t bit_length (const ubigvalue_t& value) {
+   if (value.empty()) return 0;
+   return value.size() * LIMB_BITS - countl_zero (value.back());
+}
+
+//
+// bit_slice -
+//    Bits [from, from+count) of value, as a new value.
+//
+static ubigvalue_t bit_slice (const ubigvalue_t& value, size_t from,
+                              size_t count) {
+   size_t limb = from / LIMB_BITS;
+   int bits = from % LIMB_BITS;
+   ubigvalue_t result ((count + LIMB_BITS - 1) / LIMB_BITS);
+   for (size_t index = 0; index < result.size(); ++index) {
+      size_t src = limb + index;
+      udouble_t pair = src < value.size() ? value[src] : 0;
+      if (src + 1 < value.size()) {
+         pair |= static_cast<udouble_t> (value[src + 1]) << LIMB_BITS;
+      }
+      result[index] = static_cast<udigit_t> (pair >> bits);
+   }
+   if (count % LIMB_BITS != 0 and not result.empty()) {
+      result.back() &= (udigit_t {1} << count % LIMB_BITS) - 1;
+   }
+   trim (result);
+   return result;
+}
+
+static ubigvalue_t shift_right (const ubigvalue_t& value, size_t bits) {
+   size_t length = bit_length (value);
+   if (bits >= length) return {};
+   return bit_slice (value, bits, length - bits);
+}
+
+static ubigvalue_t shift_left (const ubigvalue_t& value, size_t bits) {
+   if (value.empty()) return {};
+   size_t limbs = bits / LIMB_BITS;
+   int shift = bits % LIMB_BITS;
+   ubigvalue_t result (value.size() + limbs + 1, 0);
+   udigit_t carry = 0;
+   for (size_t index = 0; index < value.size(); ++index) {
+      result[index + limbs] = value[index] << shift | carry;
+      carry = shift == 0 ? 0 : value[index] >> (LIMB_BITS - shift);
+   }
+   result[value.size() + limbs] = carry;
+   trim (result);
+   return result;
+}
+
+static ubigvalue_t mul_mag (const ubigvalue_t& left,
+                            const ubigvalue_t& right) {
+   if (left.empty() or right.empty()) return {};
+   ubigvalue_t result (left.size() + right.size());
+   mul_limbs (result.data(), left.data(), left.size(),
+              right.data(), right.size());
+   trim (result);
+   return result;
+}
+
+static bool less_mag (const ubigvalue_t& left,
+                      const ubigvalue_t& right) {
+   return cmp_limbs (left.data(), left.size(),
+                     right.data(), right.size()) < 0;
+}
+
+//
+// divmod_knuth -
+//    Knuth, TAOCP vol 2, 4.3.1, Algorithm D.  The divisor is
+//    normalized so its top bit is set, making each estimated
+//    quotient limb at most 2 too large before correction.
+//
+static void divmod_knuth (const ubigvalue_t& dividend,
+                          const ubigvalue_t& divisor,
+                          ubigvalue_t& quotient,
+                          ubigvalue_t& remainder) {
+   if (less_mag (dividend, divisor)) {
+      quotient.clear();
+      remainder = dividend;
+      return;
+   }
+   if (divisor.size() == 1) {
+      quotient = dividend;
+      udigit_t rem = div_small (quotient, divisor[0]);
+      remainder.assign (rem == 0 ? 0 : 1, rem);
+      return;
+   }
+   int shift = countl_zero (divisor.back());
+   ubigvalue_t norm_div = shift_left (divisor, shift);
+   ubigvalue_t norm_num = shift_left (dividend, shift);
+   norm_num.resize (dividend.size() + 1, 0);
+   size_t dsize = norm_div.size();
+   size_t qsize = norm_num.size() - dsize;
+   udouble_t div_top = norm_div[dsize - 1];
+   udouble_t div_next = norm_div[dsize - 2];
+   quotient.assign (qsize, 0);
+   for (size_t pos = qsize; pos-- > 0; ) {
+      udigit_t* window = &norm_num[pos];
+      udouble_t top = static_cast<udouble_t> (window[dsize]) << LIMB_BITS
+                    | window[dsize - 1];
+      udouble_t qhat = top / div_top;
+      udouble_t rhat = top % div_top;
+      while (qhat >> LIMB_BITS != 0
+             or qhat * div_next > (rhat << LIMB_BITS
+                                   | window[dsize - 2])) {
+         --qhat;
+         rhat += div_top;
+         if (rhat >> LIMB_BITS != 0) break;
+      }
+      // window -= qhat * norm_div
+      udouble_t carry = 0;
+      udigit_t borrow = 0;
+      for (size_t index = 0; index < dsize; ++index) {
+         carry += qhat * norm_div[index];
+         udigit_t sub = static_cast<udigit_t> (carry);
+         carry >>= LIMB_BITS;
+         udigit_t limb = window[index];
+         udigit_t diff = limb - sub - borrow;
+         borrow = limb < sub or (limb == sub and borrow) ? 1 : 0;
+         window[index] = diff;
+      }
+      udouble_t top_sub = carry + borrow;
+      bool negative = window[dsize] < top_sub;
+      window[dsize] = static_cast<udigit_t> (window[dsize] - top_sub);
+      if (negative) {
+         // qhat was one too large, add the divisor back.
+         --qhat;
+         window[dsize] += add_limbs (window, window, dsize,
+                                     norm_div.data(), dsize);
+      }
+      quotient[pos] = static_cast<udigit_t> (qhat);
+   }
+   trim (quotient);
+   norm_num.resize (dsize);
+   trim (norm_num);
+   remainder = shift_right (norm_num, shift);
+}
+
+//
+// Burnikel-Ziegler recursion, in the formulation where the
+// divisor b has exactly n bits and each step divides a 2n-bit
+// number by it as two 3n/2 by n steps:
+//    div2n1n: a < b * 2^n, returns a / b and a % b.
+//    div3n2n: [a12, a3] < b * 2^n, b = [b1, b2], each of the
+//             pieces being n/2 bits.
+//
+struct limbs_quo_rem {
+   ubigvalue_t quotient;
+   ubigvalue_t remainder;
+};
+
+static limbs_quo_rem div2n1n (const ubigvalue_t& dividend,
+                              const ubigvalue_t& divisor,
+                              size_t nbits);
+
+static limbs_quo_rem div3n2n (const ubigvalue_t& high,
+                              const ubigvalue_t& low,
+                              const ubigvalue_t& divisor,
+                              const ubigvalue_t& div_high,
+                              const ubigvalue_t& div_low,
+                              size_t nbits) {
+   limbs_quo_rem result;
+   if (shift_right (high, nbits) == div_high) {
+      // The quotient would overflow nbits; 2^nbits - 1 is within
+      // two of the right answer.
+      result.quotient = shift_left (ubigvalue_t {1}, nbits);
+      result.quotient = sub_mag (result.quotient, ubigvalue_t {1});
+      result.remainder = add_mag (sub_mag (high,
+                                           shift_left (div_high, nbits)),
+                                  div_high);
+   }else {
+      result = div2n1n (high, div_high, nbits);
+   }
+   ubigvalue_t partial = add_mag (shift_left (result.remainder, nbits),
+                                  low);
+   ubigvalue_t product = mul_mag (result.quotient, div_low);
+   while (less_mag (partial, product)) {
+      result.quotient = sub_mag (result.quotient, ubigvalue_t {1});
+      partial = add_mag (partial, divisor);
+   }
+   result.remainder = sub_mag (partial, product);
+   return result;
+}
+
+static limbs_quo_rem div2n1n (const ubigvalue_t& dividend,
+                              const ubigvalue_t& divisor,
+                              size_t nbits) {
+   limbs_quo_rem result;
+   if (bit_length (dividend) <= nbits
+                                + ubigint::bz_threshold * LIMB_BITS) {
+      divmod_knuth (dividend, divisor, result.quotient,
+                    result.remainder);
+      return result;
+   }
+   if (nbits % 2 != 0) {
+      result = div2n1n (shift_left (dividend, 1),
+                        shift_left (divisor, 1), nbits + 1);
+      result.remainder = shift_right (result.remainder, 1);
+      return result;
+   }
+   size_t half = nbits / 2;
+   ubigvalue_t div_high = shift_right (divisor, half);
+   ubigvalue_t div_low = bit_slice (divisor, 0, half);
+   limbs_quo_rem upper = div3n2n (shift_right (dividend, nbits),
+                                  bit_slice (dividend, half, half),
+                                  divisor, div_high, div_low, half);
+   limbs_quo_rem lower = div3n2n (upper.remainder,
+                                  bit_slice (dividend, 0, half),
+                                  divisor, div_high, div_low, half);
+   result.quotient = add_mag (shift_left (upper.quotient, half),
+                              lower.quotient);
+   result.remainder = move (lower.remainder);
+   return result;
+}
+
+//
+// divmod_bz -
+//    Treat the dividend as a sequence of digits in base 2^n,
+//    where n is the bit length of the divisor, and run schoolbook
+//    division on those digits with div2n1n for each step.
+//
+static void divmod_bz (const ubigvalue_t& dividend,
+                       const ubigvalue_t& divisor,
+                       ubigvalue_t& quotient, ubigvalue_t& remainder) {
+   size_t nbits = bit_length (divisor);
+   size_t ndigits = (bit_length (dividend) + nbits - 1) / nbits;
+   using pool_vector = vector<ubigvalue_t, pool_allocator<ubigvalue_t>>;
+   pool_vector qdigits (ndigits);
+   ubigvalue_t rem;
+   for (size_t digit = ndigits; digit-- > 0; ) {
+      ubigvalue_t partial = add_mag (shift_left (rem, nbits),
+                                     bit_slice (dividend,
+                                                digit * nbits, nbits));
+      limbs_quo_rem step = div2n1n (partial, divisor, nbits);
+      qdigits[digit] = move (step.quotient);
+      rem = move (step.remainder);
+   }
+   quotient.assign ((ndigits * nbits + LIMB_BITS - 1) / LIMB_BITS + 1,
+                    0);
+   for (size_t digit = 0; digit < ndigits; ++digit) {
+      ubigvalue_t placed = shift_left (qdigits[digit], digit * nbits);
+      add_into (quotient.data(), quotient.size(), 0,
+                placed.data(), placed.size());
+   }
+   trim (quotient);
+   remainder = move (rem);
+}
+
+static void divmod_limbs (const ubigvalue_t& dividend,
+                          const ubigvalue_t& divisor,
+                          ubigvalue_t& quotient,
+                          ubigvalue_t& remainder) {
+   if (divisor.empty()) throw domain_error ("udivide by zero");
+   if (divisor.size() < ubigint::bz_threshold
+       or dividend.size() < divisor.size() + ubigint::bz_threshold) {
+      divmod_knuth (dividend, divisor, quotient, remainder);
+   }else {
+      divmod_bz (dividend, divisor, quotient, remainder);
+   }
+}
+
+//
+// Radix conversion -
+//    Both directions split the number around 10^(DEC_CHUNK*2^k),
+//    kept in a table built by repeated squaring, so conversion
+//    costs a logarithmic factor more than one multiplication or
+//    division of the whole number.  Below the base case sizes
+//    the linear chunk at a time loops are faster.
+//
+static constexpr size_t DEC_PARSE_BASECASE = 600;  // digits
+static constexpr size_t DEC_PRINT_BASECASE = 60;   // limbs
+
+//
+// decimal_power -
+//    10^(DEC_CHUNK * 2^level).  The table is grown on demand under
+//    a lock and kept for later conversions and powers of 10.  It
+//    is a deque so that entries never move once made, and may be
+//    used by any thread.
+//
+static const ubigvalue_t& decimal_power (size_t level) {
+   static mutex lock;
+   static deque<ubigvalue_t> powers {{DEC_RADIX}};
+   lock_guard<mutex> guard (lock);
+   while (powers.size() <= level) {
+      powers.push_back (mul_mag (powers.back(), powers.back()));
+   }
+   return powers[level];
+}
+
+//
+// decimal_split -
+//    The largest level whose power of 10 has fewer than count
+//    digits, returning that number of digits in split_digits.
+//
+static size_t decimal_split (size_t count, size_t& split_digits) {
+   size_t level = 0;
+   split_digits = DEC_CHUNK;
+   while (2 * split_digits < count) {
+      split_digits *= 2;
+      ++level;
+   }
+   return level;
+}
+
+static void parse_basecase (ubigvalue_t& value, const char* digits,
+                            size_t count) {
+   // Consume the leading partial chunk first so that every later
+   // chunk is exactly DEC_CHUNK digits long.
+   size_t chunk = count % DEC_CHUNK;
+   if (chunk == 0) chunk = DEC_CHUNK;
+   value.reserve (count / DEC_CHUNK + 1);
+   for (const char* end = digits + count; digits < end; ) {
+      udigit_t chunk_value = 0;
+      udigit_t scale = 1;
+      for (const char* stop = digits + chunk; digits < stop; ++digits) {
+         chunk_value = chunk_value * 10 + (*digits - '0');
+         scale *= 10;
+      }
+      mul_add_small (value, scale, chunk_value);
+      chunk = DEC_CHUNK;
+   }
+   trim (value);
+}
+
+static ubigvalue_t parse_decimal (const char* digits, size_t count) {
+   ubigvalue_t value;
+   if (count <= DEC_PARSE_BASECASE) {
+      parse_basecase (value, digits, count);
+      return value;
+   }
+   size_t low_digits = 0;
+   size_t level = decimal_split (count, low_digits);
+   size_t high_digits = count - low_digits;
+   value = mul_mag (parse_decimal (digits, high_digits),
+                    decimal_power (level));
+   ubigvalue_t low = parse_decimal (digits + high_digits, low_digits);
+   value.resize (max (value.size(), low.size()) + 1, 0);
+   add_into (value.data(), value.size(), 0, low.data(), low.size());
+   trim (value);
+   return value;
+}
+
+//
+// print_decimal -
+//    Writes value as exactly width digits ending just before end,
+//    padding with leading zeros.  value must be below 10^width.
+//
+static void print_decimal (const ubigvalue_t& value, char* end,
+                           size_t width) {
+   char* begin = end - width;
+   if (value.size() <= DEC_PRINT_BASECASE) {
+      ubigvalue_t rest {value};
+      while (not rest.empty() and end > begin) {
+         udigit_t chunk = div_small (rest, DEC_RADIX);
+         for (int count = 0; count < DEC_CHUNK and end > begin;
+              ++count) {
+            *--end = static_cast<char> ('0' + chunk % 10);
+            chunk /= 10;
+         }
+      }
+      fill (begin, end, '0');
+      return;
+   }
+   size_t low_digits = 0;
+   size_t level = decimal_split (width, low_digits);
+   ubigvalue_t quotient;
+   ubigvalue_t remainder;
+   divmod_limbs (value, decimal_power (level), quotient, remainder);
+   print_decimal (quotient, end - low_digits, width - low_digits);
+   print_decimal (remainder, end, low_digits);
+}
+
+//
+// power_of_10 -
+//    10^exponent = 10^(exponent % DEC_CHUNK) times the table powers
+//    10^(DEC_CHUNK * 2^level) for the bits of exponent / DEC_CHUNK,
+//    so that scaling a number by a power of 10 takes a handful of
+//    multiplications by powers already made rather than one
+//    multiplication by 10 for each digit.
+//
+ubigint ubigint::power_of_10 (size_t exponent) {
+   ubigint result;
+   udigit_t small = 1;
+   for (size_t count = exponent % DEC_CHUNK; count > 0; --count) {
+      small *= 10;
+   }
+   result.ubig_value.push_back (small);
+   size_t chunks = exponent / DEC_CHUNK;
+   for (size_t level = 0; chunks != 0; ++level, chunks >>= 1) {
+      if (chunks & 1) {
+         result.ubig_value = mul_mag (result.ubig_value,
+                                      decimal_power (level));
+      }
+   }
+   return result;
+}
 
 ubigint::ubigint (unsigned long that) {
-   DEBUGF ('~', this << " -> " << *this);
-   if (that == 0) ubig_value.push_back(that);
+   DEBUGF ('~', this << " -> " << that);
    while (that > 0) {
-      ubig_value.push_back(that%10);
-      that /= 10;
+      ubig_value.push_back (static_cast<udigit_t> (that));
+      that = LIMB_BITS < numeric_limits<unsigned long>::digits
+           ? that >> LIMB_BITS : 0;
    }
 }
 
-ubigint::ubigint (const string& that): ubig_value(0) {
+ubigint::ubigint (string_view that) {
    DEBUGF ('~', "that = \"" << that << "\"");
-   for (int i = that.length() - 1; i >= 0; i--) {
-      if (not isdigit (that[i])) {
-         throw invalid_argument ("ubigint::ubigint(" + that + ")");
-      } 
-     ubig_value.push_back(static_cast<udigit_t>(that[i] - '0'));
+   for (char digit: that) {
+      if (not isdigit (digit)) {
+         throw invalid_argument ("ubigint::ubigint("
+                                 + string (that) + ")");
+      }
    }
-   this->removeZeros();
+   ubig_value = parse_decimal (that.data(), that.size());
 }
 
 ubigint ubigint::operator+ (const ubigint& that) const {
-   int m = min (this->ubig_value.size(), that.ubig_value.size()), i = 0;
-   udigit_t n = 0, carry = 0;
-   ubigvalue_t new_value;
-   // Iterate through the minimum size of each digit.
-   // Add the two digits and if they are greater than
-   // 10, turn carry to 1, else 0.
-   while (i < m) {
-      n = this->ubig_value[i] + that.ubig_value[i] + carry;
-      new_value.push_back (n%10);
-      carry = n/10;
-      i++;
-   }
-   // The two while loops will handle different
-   // size digits.
-   while (i < this->ubig_value.size()) {
-      n = this->ubig_value[i] + carry;
-      new_value.push_back (n%10);
-      carry = n/10;
-      i++;
-   }
-   while (i < that.ubig_value.size()) {
-      n = that.ubig_value[i] + carry;
-      new_value.push_back (n%10);
-      carry = n/10;
-      i++;
-   }
-   new_value.push_back (carry);
-   ubigint new_bigint;
-   new_bigint.ubig_value = new_value;
-   new_bigint.removeZeros();
-   return new_bigint;
+   const ubigvalue_t& big = ubig_value.size() >= that.ubig_value.size()
+                          ? ubig_value : that.ubig_value;
+   const ubigvalue_t& small = &big == &ubig_value
+                            ? that.ubig_value : ubig_value;
+   ubigint result;
+   result.ubig_value.resize (big.size() + 1);
+   result.ubig_value[big.size()] =
+         add_limbs (result.ubig_value.data(), big.data(), big.size(),
+                    small.data(), small.size());
+   result.removeZeros();
+   return result;
 }
 
 ubigint ubigint::operator- (const ubigint& that) const {
    if (*this < that) throw domain_error ("ubigint::operator-(a<b)");
-   int m = min (this->ubig_value.size(), that.ubig_value.size()), i = 0;
-   int n = 0, carry = 0;
-   ubigvalue_t new_value;
-   // Iterate through the minimum size of each digit.
-   // Subtract the digit from "this" to "that", and
-   // if there is a negative value, then make carry
-   // negative, and add 10 to the value.
-   while (i < m) {
-      n = this->ubig_value[i] - that.ubig_value[i] + carry;
-      carry = n >= 0 ? 0 : -1;
-      n = n >= 0 ? n : 10 + n;
-      new_value.push_back(static_cast<udigit_t>(n));
-      i++;
-   }
-   // The two while loops will take care of handling
-   // different size digits. The algorithm is the same.
-   while (i < this->ubig_value.size()) {
-      n = this->ubig_value[i] + carry;
-      carry = n	>= 0 ? 0 : -1;
-      n	= n >= 0 ? n : 10 + n;
-      new_value.push_back(static_cast<udigit_t>(n));
-      i++;
-   }
-   while (i < that.ubig_value.size()) {
-      n = that.ubig_value[i] + carry;
-      carry = n >= 0 ? 0 : -1;
-      n = n >= 0 ? n : 10 + n;
-      new_value.push_back(static_cast<udigit_t>(n));
-      i++;
-   }
-   carry = carry < 0 ? -1 * carry : carry;
-   new_value.push_back(static_cast<udigit_t>(carry));
-   ubigint new_bigint;
-   new_bigint.ubig_value = new_value;
-   new_bigint.removeZeros();
-   return new_bigint;
+   ubigint result;
+   result.ubig_value.resize (ubig_value.size());
+   sub_limbs (result.ubig_value.data(), ubig_value.data(),
+              ubig_value.size(), that.ubig_value.data(),
+              that.ubig_value.size());
+   result.removeZeros();
+   return result;
 }
 
 ubigint ubigint::operator* (const ubigint& that) const {
-   int zeros = 0, s1 = that.ubig_value.size(), s2 = this->ubig_value.size();
-   udigit_t carry = 0, n = 0;
-   ubigvalue_t temp_value;
-   ubigint new_bigint (0), temp_bigint;
-   // Computes n number of single digit multiplication 
-   // on the "that", where n is the number of digits
-   // on "this"
-   for (int i = 0; i < s1; i++) {
-      // This for loop does the actual single digit 
-      // multiplcation on the ubig.
-      for(int j = 0; j < s2; j++) {
-         n = this->ubig_value[j] * that.ubig_value[i] + carry;
-         temp_value.push_back(n%10);
-         carry = n/10;
-      }
-      temp_value.push_back(carry);
-      carry = 0;
-      // This for loop adds the necessary zero's when
-      // generating the list of single digit
-      // multiplication on list. Increment the amount
-      // of zeros each per single digit multiplication.
-      for (int i = 0; i < zeros; i++) temp_value.insert(temp_value.begin(), 0);
-      zeros++;
-      temp_bigint.ubig_value = temp_value;
-      // After single digit multiplication is done, store
-      // it into a ubig, and add it into the final result
-      new_bigint = new_bigint + temp_bigint;
-      temp_value.clear();
-   }
-   new_bigint.removeZeros();
-   return new_bigint;
+   ubigint result;
+   if (ubig_value.empty() or that.ubig_value.empty()) return result;
+   result.ubig_value.resize (ubig_value.size()
+                             + that.ubig_value.size());
+   mul_limbs (result.ubig_value.data(),
+              ubig_value.data(), ubig_value.size(),
+              that.ubig_value.data(), that.ubig_value.size());
+   result.removeZeros();
+   return result;
 }
 
-void ubigint::multiply_by_2() {
-   ubigint bigint_two {2}, n {0};
-   n = (*this) * bigint_two;
-   ubig_value = n.ubig_value;
+ubigint& ubigint::operator+= (const ubigint& that) {
+   size_t size = max (ubig_value.size(), that.ubig_value.size());
+   ubig_value.resize (size + 1, 0);
+   ubig_value[size] = add_limbs (ubig_value.data(), ubig_value.data(),
+                                 size, that.ubig_value.data(),
+                                 that.ubig_value.size());
+   removeZeros();
+   return *this;
 }
 
-/*
-void ubigint::divide_by_2() {
-   ubigint bigint_two {2}, incr {1}, quotient {0}, divisor {*this};
-   while ((bigint_two < divisor) || (bigint_two == divisor)) {
-      quotient = quotient + incr;
-      divisor = divisor - bigint_two;
+ubigint& ubigint::operator-= (const ubigint& that) {
+   if (*this < that) throw domain_error ("ubigint::operator-=(a<b)");
+   sub_limbs (ubig_value.data(), ubig_value.data(), ubig_value.size(),
+              that.ubig_value.data(), that.ubig_value.size());
+   removeZeros();
+   return *this;
+}
+
+ubigint& ubigint::operator*= (const ubigint& that) {
+   if (ubig_value.empty() or that.ubig_value.empty()) {
+      ubig_value.clear();
+      return *this;
    }
-   ubig_value = quotient.ubig_value;
+   // mul_limbs cannot work in place, so build the product
+   // alongside and swap it in.
+   ubigvalue_t product (ubig_value.size() + that.ubig_value.size());
+   mul_limbs (product.data(), ubig_value.data(), ubig_value.size(),
+              that.ubig_value.data(), that.ubig_value.size());
+   ubig_value.swap (product);
+   removeZeros();
+   return *this;
 }
-*/
 
-void ubigint::divide_by_2() {
-   int i = ubig_value.size() - 1;
-   int quotient_ = 0;
-   ubigint divisor, quotient {0}, TWO {2};
-   // Iterate while the divisor still have values.
-   while (i >= 0) {
-      // Get the divisor
-      while (divisor < TWO && i >= 0) {
-         //divisor.ubig_value.push_back(ubig_value[i]);
-         divisor.ubig_value.insert(divisor.ubig_value.cbegin(), ubig_value[i]);
-         i--;
-      }
-      // Get quotient
-      while (divisor > TWO || divisor == TWO) {
-         divisor = divisor - TWO;
-         quotient_++;
-      }
-      quotient.ubig_value.insert(quotient.ubig_value.cbegin(), quotient_);
-      quotient_ = 0;
+ubigint& ubigint::operator/= (const ubigint& that) {
+   ubigint remainder;
+   divmod (that, remainder);
+   return *this;
+}
+
+ubigint& ubigint::operator%= (const ubigint& that) {
+   ubigint remainder;
+   divmod (that, remainder);
+   ubig_value.swap (remainder.ubig_value);
+   return *this;
+}
+
+void ubigint::divmod (const ubigint& divisor, ubigint& remainder) {
+   ubigint quotient;
+   divmod_limbs (ubig_value, divisor.ubig_value, quotient.ubig_value,
+                 remainder.ubig_value);
+   ubig_value.swap (quotient.ubig_value);
+}
+
+ubigint& ubigint::operator<<= (size_t bits) {
+   if (ubig_value.empty() or bits == 0) return *this;
+   size_t limbs = bits / LIMB_BITS;
+   int shift = bits % LIMB_BITS;
+   size_t size = ubig_value.size();
+   ubig_value.resize (size + limbs + 1, 0);
+   // Work from the top down so the move never overwrites limbs
+   // that have not been read yet.
+   for (size_t index = size + 1; index-- > 0; ) {
+      udigit_t high = index < size ? ubig_value[index] << shift : 0;
+      udigit_t low = index > 0 and shift != 0
+                   ? ubig_value[index - 1] >> (LIMB_BITS - shift) : 0;
+      ubig_value[index + limbs] = high | low;
    }
-   quotient.removeZeros();
-   ubig_value = quotient.ubig_value;
+   fill (ubig_value.begin(), ubig_value.begin() + limbs, 0);
+   removeZeros();
+   return *this;
 }
 
-
-struct quo_rem { ubigint quotient; ubigint remainder; };
-quo_rem udivide (const ubigint& dividend, const ubigint& divisor_) {
-   // NOTE: udivide is a non-member function.
-   ubigint divisor {divisor_};
-   ubigint zero {0};
-   if (divisor == zero) throw domain_error ("udivide by zero");
-   ubigint power_of_2 {1};
-   ubigint quotient {0};
-   ubigint remainder {dividend}; // left operand, dividend
-   while (divisor < remainder) {
-      divisor.multiply_by_2();
-      power_of_2.multiply_by_2();
-   }
-   while (power_of_2 > zero) {
-      if (divisor <= remainder) {
-         remainder = remainder - divisor;
-         quotient = quotient + power_of_2;
-      }
-      divisor.divide_by_2();
-      power_of_2.divide_by_2();
+ubigint& ubigint::operator>>= (size_t bits) {
+   size_t limbs = bits / LIMB_BITS;
+   int shift = bits % LIMB_BITS;
+   if (limbs >= ubig_value.size()) {
+      ubig_value.clear();
+      return *this;
+   }
+   size_t size = ubig_value.size() - limbs;
+   for (size_t index = 0; index < size; ++index) {
+      size_t src = index + limbs;
+      udigit_t low = ubig_value[src] >> shift;
+      udigit_t high = src + 1 < ubig_value.size() and shift != 0
+                    ? ubig_value[src + 1] << (LIMB_BITS - shift) : 0;
+      ubig_value[index] = low | high;
    }
-   quotient.removeZeros();
-   remainder.removeZeros();
-   return {.quotient = quotient, .remainder = remainder};
+   ubig_value.resize (size);
+   removeZeros();
+   return *this;
+}
+
+size_t ubigint::bit_length() const {
+   return ::bit_length (ubig_value);
+}
+
+ubigint::udouble_t ubigint::bits_from (size_t low) const {
+   size_t limb = low / LIMB_BITS;
+   int shift = low % LIMB_BITS;
+   udouble_t result = 0;
+   for (size_t index = 0; index < 3; ++index) {
+      if (limb + index >= ubig_value.size()) break;
+      udouble_t digit = ubig_value[limb + index];
+      int position = static_cast<int> (index) * LIMB_BITS
+                   - shift;
+      if (position < 0) result |= digit >> -position;
+      else if (position < 2 * LIMB_BITS) result |= digit << position;
+   }
+   return result;
+}
+
+void ubigint::multiply_by_2() {
+   *this <<= 1;
+}
+
+void ubigint::divide_by_2() {
+   *this >>= 1;
+}
+
+
+struct quo_rem { ubigint quotient; ubigint remainder; };
+quo_rem udivide (const ubigint& dividend, const ubigint& divisor) {
+   // NOTE: udivide is a non-member friend function.
+   quo_rem result;
+   divmod_limbs (dividend.ubig_value, divisor.ubig_value,
+                 result.quotient.ubig_value,
+                 result.remainder.ubig_value);
+   return result;
 }
 
 ubigint ubigint::operator/ (const ubigint& that) const {
@@ -217,48 +1577,93 @@ ubigint ubigint::operator% (const ubigint& that) const {
 }
 
 bool ubigint::operator== (const ubigint& that) const {
-   int x = this->ubig_value.size(), y = that.ubig_value.size();
-   if (x != y) return false;
-   for (int i = 0; i < x; i++)
-      if (this->ubig_value[i] != that.ubig_value[i]) return false;
-   return true;
+   return ubig_value == that.ubig_value;
 }
 
 bool ubigint::operator< (const ubigint& that) const {
-   int x = this->ubig_value.size(), y = that.ubig_value.size();
-   if (x < y) return true;
-   if (x > y) return false; 
-   for (int i = x - 1; i >= 0; i--) {
-      if (this->ubig_value[i] < that.ubig_value[i]) return true;
-      if (this->ubig_value[i] > that.ubig_value[i]) return false;
-   }
-   return false;   
+   return cmp_limbs (ubig_value.data(), ubig_value.size(),
+                     that.ubig_value.data(), that.ubig_value.size()) < 0;
 }
 
 bool ubigint::operator> (const ubigint& that) const {
-   int x = this->ubig_value.size(), y = that.ubig_value.size();
-   if (x < y) return false;
-   if (x > y) return true;
-   for (int i = x - 1; i >= 0; i--) {
-      if (this->ubig_value[i] < that.ubig_value[i]) return false;
-      if (this->ubig_value[i] > that.ubig_value[i]) return true;
+   return that < *this;
+}
+
+ostream& operator<< (ostream& out, const ubigint& that) {
+   if (that.ubig_value.empty()) return out << '0';
+   // Each bit is worth log10(2) < 0.30103 digits, so this width
+   // always suffices; the excess comes out as leading zeros.
+   size_t width = that.bit_length() * 30103 / 100000 + 1;
+   string digits (width, '0');
+   print_decimal (that.ubig_value, digits.data() + width, width);
+   size_t first = min (digits.find_first_not_of ('0'), width - 1);
+   return out.write (digits.data() + first, width - first);
+}
+
+void ubigint::removeZeros () {
+   while (not ubig_value.empty() and ubig_value.back() == 0)
+      ubig_value.pop_back();
+}
+
+montgomery::montgomery (const ubigint& modulus_): modulus (modulus_) {
+   if (not modulus.is_odd()) {
+      throw domain_error ("montgomery: modulus must be odd");
    }
-   return false;
+   // Newton's iteration for 1/m mod 2^LIMB_BITS; m*m == 1 mod 8,
+   // so m itself is correct to 3 bits and each step doubles that.
+   udigit_t low = modulus.ubig_value[0];
+   udigit_t inverse = low;
+   for (int bits = 3; bits < LIMB_BITS; bits *= 2) {
+      inverse *= 2 - low * inverse;
+   }
+   neg_inverse = -inverse;
+   r_squared = ubigint (1);
+   r_squared <<= 2 * LIMB_BITS * modulus.ubig_value.size();
+   r_squared %= modulus;
 }
 
-ostream& operator<< (ostream& out, const ubigint& that) { 
-   string expr = "";
-   for (int i = that.ubig_value.size() - 1; i >= 0; i--)
-      expr += to_string(that.ubig_value[i]);
-   return out << expr;
+//
+// reduce -
+//    value = value / R mod m, for value < m * R.  Each pass clears
+//    the lowest remaining limb by adding a multiple of m.
+//
+void montgomery::reduce (ubigint& value) const {
+   const ubigvalue_t& mod = modulus.ubig_value;
+   size_t size = mod.size();
+   ubigvalue_t& limbs = value.ubig_value;
+   limbs.resize (2 * size + 1, 0);
+   for (size_t pos = 0; pos < size; ++pos) {
+      udouble_t mult = static_cast<udigit_t> (limbs[pos] * neg_inverse);
+      udouble_t carry = 0;
+      for (size_t index = 0; index < size; ++index) {
+         carry += mod[index] * mult + limbs[pos + index];
+         limbs[pos + index] = static_cast<udigit_t> (carry);
+         carry >>= LIMB_BITS;
+      }
+      for (size_t index = pos + size; carry != 0; ++index) {
+         carry += limbs[index];
+         limbs[index] = static_cast<udigit_t> (carry);
+         carry >>= LIMB_BITS;
+      }
+   }
+   limbs.erase (limbs.begin(), limbs.begin() + size);
+   value.removeZeros();
+   if (not (value < modulus)) value -= modulus;
 }
 
-void ubigint::operator= (const ubigint& that) {
-   ubig_value = that.ubig_value;
+ubigint montgomery::to_form (const ubigint& value) const {
+   return multiply (value % modulus, r_squared);
 }
 
-void ubigint::removeZeros () {
-   while (ubig_value.size() > 1 and ubig_value.back() == 0)
-      ubig_value.pop_back();
+ubigint montgomery::from_form (const ubigint& value) const {
+   ubigint result {value};
+   reduce (result);
+   return result;
 }
 
+ubigint montgomery::multiply (const ubigint& left,
+                              const ubigint& right) const {
+   ubigint product {left * right};
+   reduce (product);
+   return product;
+}
@@ -3,29 +3,77 @@
 #ifndef __UBIGINT_H__
 #define __UBIGINT_H__
 
+#include <cstdint>
 #include <exception>
 #include <iostream>
 #include <limits>
+#include <string>
+#include <string_view>
 #include <utility>
 #include <vector>
 using namespace std;
 
 #include "debug.h"
 #include "relops.h"
+#include "smallvec.h"
+
+//
+// ubigint -
+//    Unsigned arbitrary precision integer.  The value is kept as
+//    a little-endian vector of binary limbs of udigit_t, with
+//    udouble_t wide enough to hold any limb product plus carries.
+//    Small values live inside the object (see smallvec).
+//    There are never any high order zero limbs, so zero is the
+//    empty vector.  Decimal is only seen by the string
+//    constructor, which converts straight from the digits with
+//    no intermediate copy, and by operator<<.
+//
+struct quo_rem;
 
 class ubigint {
    friend ostream& operator<< (ostream&, const ubigint&);
+   friend quo_rem udivide (const ubigint&, const ubigint&);
+   friend class montgomery;
+   public:
+      using udigit_t = uint32_t;
+      using udouble_t = uint64_t;
+      static constexpr int LIMB_BITS =
+                       numeric_limits<udigit_t>::digits;
+      // Values of up to 128 bits are held without allocation.
+      static constexpr size_t INLINE_LIMBS = 128 / LIMB_BITS;
+      using ubigvalue_t = smallvec<udigit_t, INLINE_LIMBS>;
    private:
-      using udigit_t = unsigned char;
-      using ubigvalue_t = vector<udigit_t>;
       ubigvalue_t ubig_value;
    public:
+      // Multiplication algorithm cutoffs, in limbs of the shorter
+      // operand.  Settable so that ybench can measure them.
+      static size_t karatsuba_threshold;
+      static size_t toom3_threshold;
+      static size_t ntt_threshold;
+      // Division switches from Algorithm D to Burnikel-Ziegler
+      // when both divisor and quotient are at least this long.
+      static size_t bz_threshold;
+      // Products whose shorter operand has at least
+      // parallel_threshold limbs, and all NTT products, are shared
+      // out over up to thread_limit threads.
+      static size_t parallel_threshold;
+      static size_t thread_limit;
+      // Whether addition, subtraction and comparison use the AVX2
+      // kernels.  Starts out true when the processor has AVX2.
+      static bool vector_kernels;
+
       void multiply_by_2();
       void divide_by_2();
 
       ubigint() = default; // Need default ctor as well.
+      ubigint (const ubigint&) = default;
+      ubigint (ubigint&&) noexcept = default;
+      ubigint& operator= (const ubigint&) = default;
+      ubigint& operator= (ubigint&&) noexcept = default;
       ubigint (unsigned long);
-      ubigint (const string&);
+      ubigint (string_view);
+      // 10^exponent, made from a table of precomputed powers.
+      static ubigint power_of_10 (size_t exponent);
 
       ubigint operator+ (const ubigint&) const;
       ubigint operator- (const ubigint&) const;
@@ -33,12 +81,57 @@ class ubigint {
       ubigint operator/ (const ubigint&) const;
       ubigint operator% (const ubigint&) const;
 
+      // In place versions reuse this object's storage where
+      // they can.  divmod replaces *this by the quotient and
+      // stores the remainder, from a single division.
+      ubigint& operator+= (const ubigint&);
+      ubigint& operator-= (const ubigint&);
+      ubigint& operator*= (const ubigint&);
+      ubigint& operator/= (const ubigint&);
+      ubigint& operator%= (const ubigint&);
+      ubigint& operator<<= (size_t bits);
+      ubigint& operator>>= (size_t bits);
+      void divmod (const ubigint& divisor, ubigint& remainder);
+
+      bool is_zero() const { return ubig_value.empty(); }
+      bool is_odd() const {
+         return not ubig_value.empty() and (ubig_value[0] & 1);
+      }
+      size_t bit_length() const;
+      // The 2 * LIMB_BITS bits of the value from bit low up.
+      udouble_t bits_from (size_t low) const;
+      bool bit (size_t index) const {
+         size_t limb = index / LIMB_BITS;
+         return limb < ubig_value.size()
+            and (ubig_value[limb] >> index % LIMB_BITS & 1);
+      }
+
       bool operator== (const ubigint&) const;
       bool operator<  (const ubigint&) const;
       bool operator>  (const ubigint&) const;
-      void operator=  (const ubigint&);
 
       void removeZeros ();
 };
 
+//
+// montgomery -
+//    Multiplication modulo a fixed odd modulus m in Montgomery
+//    form, x * R mod m where R = 2^(LIMB_BITS * limbs of m), so
+//    that each reduction needs only limb multiplications and a
+//    shift instead of a division.  Values passed to multiply and
+//    from_form must already be in Montgomery form.
+//
+class montgomery {
+   private:
+      ubigint modulus;
+      ubigint::udigit_t neg_inverse; // -1/m mod 2^LIMB_BITS
+      ubigint r_squared;             // R^2 mod m
+      void reduce (ubigint&) const;
+   public:
+      explicit montgomery (const ubigint& modulus);
+      ubigint to_form (const ubigint&) const;
+      ubigint from_form (const ubigint&) const;
+      ubigint multiply (const ubigint&, const ubigint&) const;
+};
+
 #endif
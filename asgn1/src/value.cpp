@@ -0,0 +1,49 @@
+// $Id: value.cpp,v 1.3 2026-10-17 12:00:00-07 - - $
+
+#include <cassert>
+#include <utility>
+using namespace std;
+
+#include "bytecode.h"
+#include "util.h"
+#include "value.h"
+
+ydc_value::ydc_value (decimal&& number):
+           number_ (make_shared<decimal> (move (number))) {
+}
+
+ydc_value::ydc_value (string_view text):
+           text_ (make_shared<const macro_text> (text)) {
+}
+
+const decimal& ydc_value::number() const {
+   if (is_string()) throw ydc_exn ("non-numeric value");
+   return *number_;
+}
+
+decimal& ydc_value::number_for_update() {
+   if (is_string()) throw ydc_exn ("non-numeric value");
+   if (number_.use_count() > 1) {
+      number_ = make_shared<decimal> (*number_);
+   }
+   return *number_;
+}
+
+const string& ydc_value::text() const {
+   assert (is_string());
+   return text_->text;
+}
+
+shared_ptr<program> ydc_value::code() const {
+   assert (is_string());
+   if (text_->code == nullptr) {
+      scanner input (text_->text);
+      text_->code = compile (input);
+   }
+   return text_->code;
+}
+
+ostream& operator<< (ostream& out, const ydc_value& value) {
+   if (value.is_string()) return out << value.text_->text;
+   return out << *value.number_;
+}
@@ -0,0 +1,46 @@
+// $Id: value.h,v 1.3 2026-10-17 12:00:00-07 - - $
+
+#ifndef __VALUE_H__
+#define __VALUE_H__
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+using namespace std;
+
+#include "decimal.h"
+
+//
+// ydc_value -
+//    An element of the ydc stack or of a register: either a number
+//    or a string, which x runs as a macro.  Copies share the
+//    number or string through a reference count, so that d and l
+//    take the same time however long the value is.  A number that
+//    is shared is copied only when it is about to be changed, by
+//    number_for_update.  A string keeps its compiled form
+//    alongside, made the first time it is run.
+//
+struct program;
+
+class ydc_value {
+   friend ostream& operator<< (ostream&, const ydc_value&);
+   private:
+      shared_ptr<decimal> number_;
+      struct macro_text {
+         string text;
+         mutable shared_ptr<program> code;
+         explicit macro_text (string_view chars): text (chars) {}
+      };
+      shared_ptr<const macro_text> text_;
+   public:
+      explicit ydc_value (decimal&&);
+      explicit ydc_value (string_view);
+      bool is_string() const { return text_ != nullptr; }
+      const decimal& number() const;
+      decimal& number_for_update();
+      const string& text() const;
+      shared_ptr<program> code() const;
+};
+
+#endif
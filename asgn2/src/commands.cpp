@@ -1,15 +1,17 @@
-// $Id: commands.cpp,v 1.17 2018-01-25 14:02:55-08 - - $
+// $Id: commands.cpp,v 1.24 2026-10-17 12:00:00-07 - - $
 
 #include "commands.h"
 #include "debug.h"
 #include "file_sys.h"
 #include <iomanip>
+#include <unordered_map>
 
 command_hash cmd_hash {
    {"cat"   , fn_cat   },
    {"cd"    , fn_cd    },
    {"echo"  , fn_echo  },
    {"exit"  , fn_exit  },
+   {"head"  , fn_head  },
    {"ls"    , fn_ls    },
    {"lsr"   , fn_lsr   },
    {"make"  , fn_make  },
@@ -18,6 +20,7 @@ command_hash cmd_hash {
    {"pwd"   , fn_pwd   },
    {"rm"    , fn_rm    },
    {"rmr"   , fn_rmr   },
+   {"touch" , fn_touch },
    {"#"     , fn_ignore}
 };
 
@@ -58,22 +61,47 @@ wordvec get_path (const wordvec& command) {
    return path;
 }
 
+// find_dir -
+//    The directory a pathname names.  It is an error if there is no
+//    such directory.
+inode_ptr find_dir (inode_state& state, const string& pathname) {
+   inode_ptr dir = state.resolve (pathname);
+   if (dir == nullptr)
+      throw command_error (pathname + ": no such directory");
+   if (dir->contents->get_type() != file_type::DIRECTORY_TYPE)
+      throw command_error (pathname + ": not a directory");
+   return dir;
+}
+
+// split_last -
+//    Splits a pathname into the directory its last component is in
+//    and that component, which may not be . or .. or missing.
+pair<string,string> split_last (const string& pathname) {
+   size_t end = pathname.find_last_not_of ('/');
+   size_t slash = end == string::npos ? string::npos
+                : pathname.rfind ('/', end);
+   string name = end == string::npos ? ""
+               : pathname.substr (slash + 1, end - slash);
+   if (name == "" or name == "." or name == "..")
+      throw command_error (pathname + ": invalid pathname");
+   if (slash == string::npos) return {".", name};
+   return {slash == 0 ? "/" : pathname.substr (0, slash), name};
+}
+
 void fn_cat (inode_state& state, const wordvec& words){
    DEBUGF ('c', state);
    DEBUGF ('c', words);
    wordvec path = get_path(words);
    if (path.size() == 0) throw command_error ("No files selected.");
-   wordvec contents;
    for (string file : path) {
-      if (!state.cwd->contents->find(file))
+      inode_ptr node = state.resolve (file);
+      if (node == nullptr)
          //throw command_error (file + " not found");
          cout << file << " not found" << endl;
-      else if (state.cwd->contents->search_dir(file)->contents->get_type() == file_type::DIRECTORY_TYPE)
+      else if (node->contents->get_type() == file_type::DIRECTORY_TYPE)
          throw command_error("Cannot cat a directory");
-      else {
-         contents = state.cwd->contents->search_dir(file)->contents->readfile();
-         cout << word_range (contents.cbegin(), contents.cend());
-      }
+      else
+         cout << node->contents->readfile();
    }
    cout << endl;
 }
@@ -82,19 +110,9 @@ void fn_cd (inode_state& state, const wordvec& words){
    DEBUGF ('c', state);
    DEBUGF ('c', words);
    wordvec path = get_path(words);
-   if (path.size() == 0 or path[0] == "/") {
-      if (state.cwd != nullptr)
-         state.cwd.reset();
-         state.cwd = state.root;
-   } else {
-      for (string dir : path) {
-         if (state.cwd->contents->search_dir(dir)->contents->get_type() == file_type::PLAIN_TYPE)
-            throw command_error ("Cannot cd into a file");
-         inode_ptr temp = state.cwd->contents->search_dir(dir);
-         state.cwd.reset();
-         state.cwd = temp;
-      }
-   }
+   string dirname = path.size() == 0 ? "/" : path[0];
+   inode_ptr dir = find_dir (state, dirname);
+   state.set_cwd (dir, state.canonical (dirname));
 }
 
 void fn_echo (inode_state& state, const wordvec& words){
@@ -110,6 +128,28 @@ void fn_exit (inode_state& state, const wordvec& words){
    throw ysh_exit();
 }
 
+// head count pathname... -
+//    Prints the first count chars of each file, each on a line of
+//    its own, written straight from the file's chunks.
+void fn_head (inode_state& state, const wordvec& words){
+   DEBUGF ('c', state);
+   DEBUGF ('c', words);
+   wordvec path = get_path(words);
+   if (path.size() < 2 or path[0].empty()
+       or path[0].find_first_not_of ("0123456789") != string::npos)
+      throw command_error ("usage: head count pathname...");
+   size_t count = stoul (path[0]);
+   for (auto file = path.cbegin() + 1; file != path.cend(); ++file) {
+      inode_ptr node = state.resolve (*file);
+      if (node == nullptr)
+         throw command_error (*file + " not found");
+      if (node->contents->get_type() == file_type::DIRECTORY_TYPE)
+         throw command_error (*file + ": is a directory");
+      node->contents->readfile().write (cout, 0, count);
+      cout << endl;
+   }
+}
+
 void print_path (const wordvec& path) {
    cout << path[0];
    for (int i = 1; i < path.size() - 1; i++)
@@ -144,10 +184,9 @@ void fn_ls (inode_state& state, const wordvec& words){
    DEBUGF ('c', state);
    DEBUGF ('c', words);
    wordvec path = get_path(words);
-   inode_ptr temp = state.cwd;   
-   if (path.size() > 0) fn_cd (state, words);
-   ls_helper(state.cwd->contents);
-   state.cwd = temp;
+   if (path.size() == 0) path.push_back (".");
+   for (const string& dirname : path)
+      ls_helper (find_dir (state, dirname)->contents);
 }
 
 void lsr_helper(const base_file_ptr& base) {
@@ -169,10 +208,10 @@ void lsr_helper(const base_file_ptr& base) {
 void fn_lsr (inode_state& state, const wordvec& words){
    DEBUGF ('c', state);
    DEBUGF ('c', words);
-   inode_state state_ = state;
    wordvec path	= get_path(words);
-   if (path.size() > 0) fn_cd (state_, words);
-   lsr_helper(state_.cwd->contents);
+   if (path.size() == 0) path.push_back (".");
+   for (const string& dirname : path)
+      lsr_helper (find_dir (state, dirname)->contents);
 }
 
 void fn_make (inode_state& state, const wordvec& words) {
@@ -180,14 +219,44 @@ void fn_make (inode_state& state, const wordvec& words) {
    DEBUGF ('c', words);
    wordvec path = get_path(words);
    if (path.size() == 0) throw command_error ("No file specified.");
-   if (state.cwd->contents->find(path[0]))
+   auto [dirname, name] = split_last (path[0]);
+   inode_ptr dir = find_dir (state, dirname);
+   if (dir->contents->find(name))
       cout << path[0] << "already exists" << endl;
    else {
-      inode_ptr new_inode =  state.cwd->contents->mkfile(path[0]);
-      wordvec data;
-      for (int i = 1; i < path.size(); i++)
-         data.push_back(path[i]);
-      state.cwd->contents->write_to_file(path[0], data);
+      inode_ptr new_inode =  dir->contents->mkfile(name);
+      new_inode->contents->writefile(word_range (path.cbegin() + 1,
+                                                 path.cend()));
+      state.forget (path[0]);
+   }
+}
+
+// mkdir_parents -
+//    mkdir -p:  makes each directory along a pathname that is not
+//    there yet, and passes over those that are.  The pathname is
+//    walked down one entry at a time from / or the cwd.  Nothing
+//    is removed, so the dentry cache need not be told.
+void mkdir_parents (inode_state& state, const string& pathname) {
+   bool absolute = not pathname.empty() and pathname[0] == '/';
+   inode_ptr dir = absolute ? state.root : state.cwd;
+   string walked = absolute ? "/" : "";
+   for (const string& name : split (pathname, "/")) {
+      if (not walked.empty() and walked.back() != '/') walked += "/";
+      walked += name;
+      if (name == ".") continue;
+      inode_ptr* entry = dir->contents->entry (name);
+      inode_ptr next;
+      if (entry != nullptr) {
+         next = *entry;
+      }else if (name == "..") {
+         throw command_error (walked + ": no such directory");
+      }else {
+         next = dir->contents->mkdir(name);
+         dir->contents->init_dir(name, next, dir);
+      }
+      if (next->contents->get_type() != file_type::DIRECTORY_TYPE)
+         throw command_error (walked + ": not a directory");
+      dir = next;
    }
 }
 
@@ -195,12 +264,25 @@ void fn_mkdir (inode_state& state, const wordvec& words){
    DEBUGF ('c', state);
    DEBUGF ('c', words);
    wordvec path = get_path(words);
+   bool parents = path.size() > 0 and path[0] == "-p";
+   if (parents) path.erase (path.begin());
    if (path.size() == 0) throw command_error ("No name specified.");
-   if (state.cwd->contents->find(path[0]))
-      cout << path[0] << "already exists" << endl;
-   else {
-      inode_ptr new_inode = state.cwd->contents->mkdir(path[0]);
-      state.cwd->contents->init_dir(path[0], new_inode, state.cwd);
+   if (parents and path[0] == "-p")
+      throw command_error ("-p: given more than once");
+   for (const string& pathname : path) {
+      if (parents) {
+         mkdir_parents (state, pathname);
+         continue;
+      }
+      auto [dirname, name] = split_last (pathname);
+      inode_ptr dir = find_dir (state, dirname);
+      if (dir->contents->find(name))
+         cout << pathname << "already exists" << endl;
+      else {
+         inode_ptr new_inode = dir->contents->mkdir(name);
+         dir->contents->init_dir(name, new_inode, dir);
+         state.forget (pathname);
+      }
    }
 }
 
@@ -224,7 +306,9 @@ void fn_rm (inode_state& state, const wordvec& words){
    DEBUGF ('c', words);
    wordvec path	= get_path(words);
    if (path.size() == 0) throw command_error ("No path specified");
-   state.cwd->contents->remove(path[0]);
+   auto [dirname, name] = split_last (path[0]);
+   find_dir (state, dirname)->contents->remove(name);
+   state.forget (path[0]);
 }
 
 // Recursively removes the files or directory.
@@ -232,15 +316,16 @@ void rmr_helper (base_file_ptr& base, const string& n) {
    if(base->search_dir(n)->contents->get_type() == file_type::PLAIN_TYPE) {
       base->remove(n);
    } else {
-      dirents_itr itr = base->search_dir(n)->contents->get_itr();
-      auto it_b = itr.itr_b, it_e = itr.itr_e;
-      while (it_b != it_e) {
-         if (it_b->second->contents->get_type() == file_type::PLAIN_TYPE)
-            it_b->second->contents->remove(it_b->first);
-         else if (it_b->first != "." && it_b->first != "..")
-            rmr_helper(it_b->second->contents, it_b->first);
-         it_b++;
-      }
+      // The names are copied out first, since removing them
+      // invalidates the iterators.
+      base_file_ptr dir = base->search_dir(n)->contents;
+      dirents_itr itr = dir->get_itr();
+      wordvec names;
+      for (auto it_b = itr.itr_b; it_b != itr.itr_e; it_b++)
+         if (it_b->first != "." && it_b->first != "..")
+            names.push_back(it_b->first);
+      for (const string& name : names)
+         rmr_helper(dir, name);
       base->remove(n);
    }
 }
@@ -250,8 +335,34 @@ void fn_rmr (inode_state& state, const wordvec& words){
    DEBUGF ('c', words);
    wordvec path = get_path(words);
    if (path.size() == 0) throw command_error ("No path specified");
-   rmr_helper(state.cwd->contents, path[0]);
+   auto [dirname, name] = split_last (path[0]);
+   rmr_helper(find_dir (state, dirname)->contents, name);
+   state.forget (path[0]);
 }
+
+// Makes empty files for the pathnames that do not exist yet.  The
+// names going into each directory are made together, so that it
+// sorts them all in at once.  The directories are taken in the order
+// they first appear, so that inode numbers follow the operands.
+void fn_touch (inode_state& state, const wordvec& words){
+   DEBUGF ('c', state);
+   DEBUGF ('c', words);
+   wordvec path = get_path(words);
+   if (path.size() == 0) throw command_error ("No file specified.");
+   vector<pair<inode_ptr,wordvec>> batches;
+   unordered_map<inode*,size_t> batch_of;
+   for (const string& pathname : path) {
+      auto [dirname, name] = split_last (pathname);
+      inode_ptr dir = find_dir (state, dirname);
+      auto [found, added] = batch_of.emplace (dir.get(), batches.size());
+      if (added) batches.emplace_back (dir, wordvec());
+      batches[found->second].second.push_back (name);
+   }
+   for (const auto& [dir, names] : batches)
+      dir->contents->mkfiles (names);
+   for (const string& pathname : path) state.forget (pathname);
+}
+
 /* My code ends */
 
 void fn_ignore(inode_state& state, const wordvec& words) {}
@@ -1,4 +1,4 @@
-// $Id: commands.h,v 1.11 2016-01-14 14:45:21-08 - - $
+// $Id: commands.h,v 1.13 2026-10-17 12:00:00-07 - - $
 
 #ifndef __COMMANDS_H__
 #define __COMMANDS_H__
@@ -29,6 +29,7 @@ void fn_cat    (inode_state& state, const wordvec& words);
 void fn_cd     (inode_state& state, const wordvec& words);
 void fn_echo   (inode_state& state, const wordvec& words);
 void fn_exit   (inode_state& state, const wordvec& words);
+void fn_head   (inode_state& state, const wordvec& words);
 void fn_ls     (inode_state& state, const wordvec& words);
 void fn_lsr    (inode_state& state, const wordvec& words);
 void fn_make   (inode_state& state, const wordvec& words);
@@ -37,6 +38,7 @@ void fn_prompt (inode_state& state, const wordvec& words);
 void fn_pwd    (inode_state& state, const wordvec& words);
 void fn_rm     (inode_state& state, const wordvec& words);
 void fn_rmr    (inode_state& state, const wordvec& words);
+void fn_touch  (inode_state& state, const wordvec& words);
 void fn_ignore (inode_state& state, const wordvec& words);
 
 command_fn find_command_fn (const string& command);
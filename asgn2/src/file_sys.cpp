@@ -1,5 +1,6 @@
-// $Id: file_sys.cpp,v 1.6 2018-06-27 14:44:57-07 - - $
+// $Id: file_sys.cpp,v 1.15 2026-10-17 12:00:00-07 - - $
 
+#include <algorithm>
 #include <iostream>
 #include <stdexcept>
 #include <unordered_map>
@@ -9,7 +10,12 @@ using namespace std;
 #include "debug.h"
 #include "file_sys.h"
 
-int inode::next_inode_nr {1};
+vector<unique_ptr<inode[]>> inode_table::slabs;
+size_t inode_table::count {0};
+vector<inode*> inode_table::free_slots;
+int inode_table::next_inode_nr {1};
+vector<inode*> inode_table::unreferenced;
+bool inode_table::freeing {false};
 
 struct file_type_hash {
    size_t operator() (file_type type) const {
@@ -31,7 +37,7 @@ ostream& operator<< (ostream& out, file_type type) {
 inode_state::inode_state() {
    DEBUGF ('i', "root = " << root << ", cwd = " << cwd
           << ", prompt = \"" << prompt() << "\"");
-   root = make_shared<inode>(file_type::DIRECTORY_TYPE);
+   root = inode_table::make(file_type::DIRECTORY_TYPE);
    root->contents->insert_dir_("..", root);
    root->contents->insert_dir_(".", root);
    root->contents->update_path(root->contents->get_path(), "/");
@@ -53,6 +59,7 @@ inode_state::inode_state (const inode_ptr& that) {
 void inode_state::operator= (const inode_state& that) {
    cwd.reset();
    cwd = that.cwd;
+   cwd_path = that.cwd_path;
    root.reset();
    root = that.root;
    //prompt_ = that.prompt_();
@@ -60,17 +67,215 @@ void inode_state::operator= (const inode_state& that) {
 
 void inode_state::set_prompt (const string& prompt) { prompt_ = prompt + " "; }
 
-// Make the contents point to the type passed in
-inode::inode(file_type type): inode_nr (next_inode_nr++) {
+// The absolute pathname of a list of names, as /a/b/c.
+static string joined (const wordvec& path) {
+   if (path.empty()) return "/";
+   string result;
+   for (const string& name : path) result += "/" + name;
+   return result;
+}
+
+// Only the names matter here, so . and .. are dealt with before
+// anything is looked up.
+string inode_state::canonical (const string& pathname) const {
+   wordvec path;
+   if (pathname.empty() or pathname[0] != '/') path = cwd_path;
+   for (const string& name : split (pathname, "/")) {
+      if (name == ".") continue;
+      if (name == "..") {
+         if (not path.empty()) path.pop_back();
+      }else {
+         path.push_back (name);
+      }
+   }
+   return joined (path);
+}
+
+// A relative pathname is walked down from the cwd inode itself,
+// since the cwd may no longer be where its name says, if it or a
+// directory above it has been removed.  A removed directory has
+// dropped its own . entry, so . is taken as the directory itself.
+// An absolute pathname is taken apart by name to use the cache, but
+// what comes before each . or .. must still be a directory, as it
+// must be when walking.
+inode_ptr inode_state::resolve (const string& pathname) {
+   if (not pathname.empty() and pathname[0] == '/') {
+      wordvec path;
+      for (const string& name : split (pathname, "/")) {
+         if (name != "." and name != "..") {
+            path.push_back (name);
+            continue;
+         }
+         inode_ptr dir = lookup (joined (path));
+         if (dir == nullptr
+             or dir->contents->get_type() != file_type::DIRECTORY_TYPE) {
+            return nullptr;
+         }
+         if (name == ".." and not path.empty()) path.pop_back();
+      }
+      return lookup (joined (path));
+   }
+   inode_ptr node = cwd;
+   for (const string& name : split (pathname, "/")) {
+      if (node->contents->get_type() != file_type::DIRECTORY_TYPE) {
+         return nullptr;
+      }
+      if (name == ".") continue;
+      inode_ptr* entry = node->contents->entry (name);
+      if (entry == nullptr) return nullptr;
+      node = *entry;
+   }
+   return node;
+}
+
+// A miss looks up the parent first, so each directory on the way
+// down is cached as well, and a cached name always has its parent
+// cached.  Names that do not exist are not cached.
+inode_ptr inode_state::lookup (const string& canonical_path) {
+   if (canonical_path == "/") return root;
+   const auto found = dentries.find (canonical_path);
+   if (found != dentries.end()) return found->second;
+   size_t slash = canonical_path.rfind ('/');
+   inode_ptr parent = lookup (slash == 0 ? string ("/")
+                            : canonical_path.substr (0, slash));
+   inode_ptr result {nullptr};
+   if (parent != nullptr
+       and parent->contents->get_type() == file_type::DIRECTORY_TYPE) {
+      inode_ptr* entry = parent->contents->entry (
+                            canonical_path.substr (slash + 1));
+      if (entry != nullptr) result = *entry;
+   }
+   if (result != nullptr) dentries.emplace (canonical_path, result);
+   return result;
+}
+
+// Only a directory can have anything cached under it, so it is
+// only then that the whole cache has to be looked through.
+void inode_state::forget (const string& pathname) {
+   string key = canonical (pathname);
+   if (key == "/") {
+      dentries.clear();
+      return;
+   }
+   const auto found = dentries.find (key);
+   if (found == dentries.end()) return;
+   bool is_dir = found->second->contents->get_type()
+              == file_type::DIRECTORY_TYPE;
+   dentries.erase (found);
+   if (not is_dir) return;
+   for (auto itor = dentries.begin(); itor != dentries.end();) {
+      const string& cached = itor->first;
+      if (cached.size() > key.size() and cached[key.size()] == '/'
+          and cached.compare (0, key.size(), key) == 0) {
+         itor = dentries.erase (itor);
+      }else {
+         ++itor;
+      }
+   }
+}
+
+void inode_state::set_cwd (const inode_ptr& dir,
+                           const string& canonical_path) {
+   cwd = dir;
+   cwd_path = split (canonical_path, "/");
+}
+
+inode_ptr::inode_ptr (inode* that): node (that) {
+   if (node != nullptr) ++node->refs;
+}
+
+inode_ptr::inode_ptr (const inode_ptr& that): node (that.node) {
+   if (node != nullptr) ++node->refs;
+}
+
+inode_ptr::inode_ptr (inode_ptr&& that) noexcept:
+           node (that.node), counted (that.counted) {
+   that.node = nullptr;
+   that.counted = true;
+}
+
+// The new inode is counted before the old one is let go, in case
+// they are the same.
+inode_ptr& inode_ptr::operator= (const inode_ptr& that) {
+   if (that.node != nullptr) ++that.node->refs;
+   release();
+   node = that.node;
+   return *this;
+}
+
+inode_ptr& inode_ptr::operator= (inode_ptr&& that) noexcept {
+   if (this == &that) return *this;
+   release();
+   node = that.node;
+   counted = that.counted;
+   that.node = nullptr;
+   that.counted = true;
+   return *this;
+}
+
+inode_ptr inode_ptr::link (const inode_ptr& that) {
+   inode_ptr result;
+   result.node = that.node;
+   result.counted = false;
+   return result;
+}
+
+void inode_ptr::release() {
+   inode* old = node;
+   bool was_counted = counted;
+   node = nullptr;
+   counted = true;
+   if (old != nullptr and was_counted and --old->refs == 0) {
+      inode_table::release (old);
+   }
+}
+
+ostream& operator<< (ostream& out, const inode_ptr& ptr) {
+   return out << static_cast<const void*> (ptr.get());
+}
+
+// A freed slot is used again before a new one is taken.  Make the
+// contents point to the type passed in.
+inode_ptr inode_table::make (file_type type) {
+   inode* slot;
+   if (not free_slots.empty()) {
+      slot = free_slots.back();
+      free_slots.pop_back();
+   }else {
+      if (count % SLAB_SIZE == 0) {
+         slabs.push_back (make_unique<inode[]> (SLAB_SIZE));
+      }
+      slot = &slabs.back()[count % SLAB_SIZE];
+      ++count;
+   }
+   inode& node = *slot;
+   node.inode_nr = next_inode_nr++;
    switch (type) {
       case file_type::PLAIN_TYPE:
-           contents = make_shared<plain_file>();
+           node.contents = make_shared<plain_file>();
            break;
       case file_type::DIRECTORY_TYPE:
-           contents = make_shared<directory>();
+           node.contents = make_shared<directory>();
            break;
    }
-   DEBUGF ('i', "inode " << inode_nr << ", type = " << type);
+   DEBUGF ('i', "inode " << node.inode_nr << ", type = " << type);
+   return inode_ptr (&node);
+}
+
+// Freeing the contents may come back here for more inodes, which
+// are only queued, since the loop below is already running.
+void inode_table::release (inode* node) {
+   unreferenced.push_back (node);
+   if (freeing) return;
+   freeing = true;
+   while (not unreferenced.empty()) {
+      inode* next = unreferenced.back();
+      unreferenced.pop_back();
+      DEBUGF ('i', "free inode " << next->inode_nr);
+      next->contents.reset();
+      free_slots.push_back (next);
+   }
+   freeing = false;
 }
 
 int inode::get_inode_nr() const {
@@ -83,26 +288,136 @@ file_error::file_error (const string& what):
             runtime_error (what) {
 }
 
-// Number of characters in the file. Length each word
-// plus the amount of spaces. Amount of spaces is just
-// size of vector.
+inode_ptr* dirent_table::find (const string& name) {
+   const auto found = index.find (name);
+   if (found == index.end()) return nullptr;
+   return &entries[found->second].second;
+}
+
+bool dirent_table::insert (const string& name, inode_ptr node) {
+   if (not index.emplace (name, entries.size()).second) return false;
+   entries.emplace_back (name, move (node));
+   return true;
+}
+
+void dirent_table::assign (const string& name, inode_ptr node) {
+   inode_ptr* slot = find (name);
+   if (slot != nullptr) *slot = move (node);
+                   else insert (name, move (node));
+}
+
+// Once the empty slots come to half as many as the names, they are
+// dropped, so that making and removing names without ever listing
+// the directory does not grow it without bound.
+bool dirent_table::erase (const string& name) {
+   const auto found = index.find (name);
+   if (found == index.end()) return false;
+   entries[found->second].second.reset();
+   index.erase (found);
+   if (entries.size() - index.size() > index.size() / 2) order();
+   return true;
+}
+
+void dirent_table::reserve (size_t count) {
+   entries.reserve (count);
+   index.reserve (count);
+}
+
+// The sorted prefix and the new names after it are each compacted
+// and then merged, and the index is pointed at the new positions.
+void dirent_table::order() {
+   if (sorted == entries.size() and index.size() == entries.size()) {
+      return;
+   }
+   auto empty = [] (const dirent& entry) {
+      return entry.second == nullptr;
+   };
+   auto by_name = [] (const dirent& left, const dirent& right) {
+      return left.first < right.first;
+   };
+   auto middle = remove_if (entries.begin(),
+                            entries.begin() + sorted, empty);
+   auto added = remove_if (entries.begin() + sorted,
+                           entries.end(), empty);
+   if (middle != entries.begin() + sorted) {
+      added = move (entries.begin() + sorted, added, middle);
+   }
+   entries.erase (added, entries.end());
+   sort (middle, entries.end(), by_name);
+   inplace_merge (entries.begin(), middle, entries.end(), by_name);
+   for (size_t pos = 0; pos < entries.size(); ++pos) {
+      index.find (entries[pos].first)->second = pos;
+   }
+   sorted = entries.size();
+}
+
+// The whole size is known first, so that each chunk is made with
+// room for just what goes in it:  CHUNK_SIZE, or the rest of the
+// text for the last.  A short file takes only its own size.
+void text_chunks::assign (word_range words) {
+   chunks.clear();
+   size_ = 0;
+   size_t total = 0;
+   for (auto itor = words.first; itor != words.second; ++itor) {
+      if (itor != words.first) ++total;
+      total += itor->size();
+   }
+   auto add = [&] (const char* text, size_t length) {
+      while (length > 0) {
+         if (chunks.empty() or chunks.back().size() == CHUNK_SIZE) {
+            chunks.emplace_back();
+            chunks.back().reserve (min (CHUNK_SIZE, total - size_));
+         }
+         string& last = chunks.back();
+         size_t count = min (length, CHUNK_SIZE - last.size());
+         last.append (text, count);
+         text += count;
+         length -= count;
+         size_ += count;
+      }
+   };
+   for (auto itor = words.first; itor != words.second; ++itor) {
+      if (itor != words.first) add (" ", 1);
+      add (itor->data(), itor->size());
+   }
+}
+
+// Every chunk but the last is full, so the one holding pos is
+// found by division.
+void text_chunks::write (ostream& out, size_t pos, size_t count) const {
+   if (pos >= size_) return;
+   count = min (count, size_ - pos);
+   size_t chunk = pos / CHUNK_SIZE;
+   size_t offset = pos % CHUNK_SIZE;
+   while (count > 0) {
+      size_t length = min (count, chunks[chunk].size() - offset);
+      out.write (chunks[chunk].data() + offset, length);
+      count -= length;
+      offset = 0;
+      ++chunk;
+   }
+}
+
+ostream& operator<< (ostream& out, const text_chunks& text) {
+   text.write (out);
+   return out;
+}
+
+// Number of characters in the file, which is kept as it is
+// written.
 size_t plain_file::size() const {
-   size_t size {0};
-   DEBUGF ('i', "size = " << size);
-   for (string word : data)
-      size += word.length();
-   size += data.size();
-   return size - 1;
+   DEBUGF ('i', "size = " << data.size());
+   return data.size();
 }
 
-const wordvec& plain_file::readfile() const {
+const text_chunks& plain_file::readfile() const {
    DEBUGF ('i', data);
    return data;
 }
 
-void plain_file::writefile (const wordvec& words) {
+void plain_file::writefile (word_range words) {
    DEBUGF ('i', words);
-   data = words;
+   data.assign (words);
 }
 
 void plain_file::remove (const string&) {
@@ -117,6 +432,14 @@ inode_ptr plain_file::mkfile (const string&) {
    throw file_error ("is a plain file");
 }
 
+void plain_file::mkfiles (const wordvec&) {
+   throw file_error ("is a plain file");
+}
+
+inode_ptr* plain_file::entry (const string&) {
+   throw file_error ("is a plain file");
+}
+
 inode_ptr plain_file::search_dir (const string& key) {
    throw file_error ("is a plain file");
 }
@@ -173,34 +496,32 @@ size_t directory::size() const {
    return size;
 }
 
-const wordvec& directory::readfile() const {
+const text_chunks& directory::readfile() const {
    throw file_error ("is a directory");
 }
 
-void directory::writefile (const wordvec&) {
+void directory::writefile (word_range) {
    throw file_error ("is a directory");
 }
 
 // If file or directory doens't exist, then throw
 // and error. If it exist and is a directory, see
 // if the directory is empty or not. If not, then
-// cannot delete.
+// cannot delete. If so, it drops its own . and ..
+// links first.
 void directory::remove (const string& filename) {
    DEBUGF ('i', filename);
-   if (dirents.find(filename) == dirents.end()) throw file_error (filename + " not found");
-   if (dirents.at(filename)->contents->get_type() == file_type::DIRECTORY_TYPE) {
-      if (dirents.at(filename)->contents->size() > 2)
+   inode_ptr* entry = dirents.find(filename);
+   if (entry == nullptr) throw file_error (filename + " not found");
+   const base_file_ptr& contents = (*entry)->contents;
+   if (contents->get_type() == file_type::DIRECTORY_TYPE) {
+      if (contents->size() > 2)
          throw file_error (filename + " must be empty");
-      else {
-         dirents.at(filename)->contents->search_dir("..").reset();
-         dirents.at(filename)->contents->search_dir(".").reset();
-         dirents.erase(filename);
-      }
-   }
-   else {
-      dirents.at(filename).reset();
-      dirents.erase(filename);
+      directory& removed = static_cast<directory&> (*contents);
+      removed.dirents.erase(".");
+      removed.dirents.erase("..");
    }
+   dirents.erase(filename);
 }
 
 // If directory already exists as a directory or file,
@@ -210,11 +531,10 @@ void directory::remove (const string& filename) {
 // dirents.
 inode_ptr directory::mkdir (const string& dirname) {
    DEBUGF ('i', dirname);
-   if (dirents.find(dirname) != dirents.end()) throw file_error (dirname + " already exists");
-   inode new_inode(file_type::DIRECTORY_TYPE);
-   new_inode.contents->update_path(path, dirname);
-   inode_ptr new_inode_ptr = make_shared<inode>(new_inode);
-   dirents.insert({dirname, new_inode_ptr});
+   if (dirents.find(dirname) != nullptr) throw file_error (dirname + " already exists");
+   inode_ptr new_inode_ptr = inode_table::make(file_type::DIRECTORY_TYPE);
+   new_inode_ptr->contents->update_path(path, dirname);
+   dirents.insert(dirname, new_inode_ptr);
    return new_inode_ptr;
 }
 
@@ -224,27 +544,47 @@ inode_ptr directory::mkdir (const string& dirname) {
 // Insert it into the dirents.
 inode_ptr directory::mkfile (const string& filename) {
    DEBUGF ('i', filename);
-   if (dirents.find(filename) != dirents.end()) throw file_error (filename + " already exists");
-   inode new_inode(file_type::PLAIN_TYPE);
-   new_inode.contents->set_name(filename);
-   inode_ptr new_inode_ptr = make_shared<inode>(new_inode);
-   dirents.insert({filename, new_inode_ptr});
+   if (dirents.find(filename) != nullptr) throw file_error (filename + " already exists");
+   inode_ptr new_inode_ptr = inode_table::make(file_type::PLAIN_TYPE);
+   new_inode_ptr->contents->set_name(filename);
+   dirents.insert(filename, new_inode_ptr);
    return new_inode_ptr;
 }
 
+void directory::mkfiles (const wordvec& filenames) {
+   DEBUGF ('i', filenames);
+   dirents.reserve(dirents.size() + filenames.size());
+   for (const string& filename : filenames) {
+      if (dirents.find(filename) != nullptr) continue;
+      inode_ptr new_inode_ptr = inode_table::make(file_type::PLAIN_TYPE);
+      new_inode_ptr->contents->set_name(filename);
+      dirents.insert(filename, new_inode_ptr);
+   }
+   dirents.order();
+}
+
+inode_ptr* directory::entry (const string& key) {
+   return dirents.find(key);
+}
+
+// Like map::at, the entry of a name that must be there.
+inode_ptr& directory::at (const string& key) {
+   inode_ptr* found = dirents.find(key);
+   if (found == nullptr) throw file_error (key + " not found");
+   return *found;
+}
+
 inode_ptr directory::search_dir (const string& key) {
-   if (dirents.find(key) == dirents.end()) throw file_error (key + "2 not found");
-   return dirents.at(key);
+   return at(key);
 }
 
 bool directory::find(const string& key) {
-   if (dirents.find(key) == dirents.end())
-      return false;
-   return true;
+   return dirents.find(key) != nullptr;
 }
 
 dirents_itr directory::get_itr () {
    dirents_itr itr;
+   dirents.order();
    itr.itr_b = dirents.begin();
    itr.itr_e = dirents.end();
    return itr;
@@ -256,39 +596,27 @@ file_type directory::get_type () {
 
 // Write to a file while in cwd. While in the cwd, find the file
 // that needs to be updated, and write the data to the file.
-// Update the cwd by inserting the new file into the dirents.
+// The file is changed through its entry, which stays where it is.
 void directory::write_to_file (const string& file, const wordvec& data) {
-   inode_ptr data_ = dirents.at(file);
-   data_->contents->writefile(data);
-   dirents.at(file).reset();
-   dirents.erase(file);
-   dirents.insert({file, data_});
+   at(file)->contents->writefile(word_range (data.cbegin(), data.cend()));
 }
 
 // Insert something into the directory dir, while in cwd. This is
 // used when adding "." and ".." when making a new directory. The
-// cwd simply find the new directory created, and calls insert_dir_.
-// After updating the new directory, the cwd needs to update it's
-// own directory by inserting the newly updated directory into its
-// own.
+// cwd simply find the new directory created, and calls insert_dir_
+// on it through its entry.
 void directory::insert_dir (const string& dir, const string& key, const inode_ptr& value) {
-   inode_ptr value_ = dirents.at(dir);
-   value_->contents->insert_dir_(key, value);
-   dirents.at(dir).reset();
-   dirents.erase(dir);
-   dirents.insert({dir, value_});
+   at(dir)->contents->insert_dir_(key, value);
 }
 
-// Simply insert something into the map. This is usefull for the 
-// inode_state constructor because it can directly create the "."
-// and ".." when initiated.
+// Simply insert something into the dirents, replacing what is
+// there. This is usefull for the inode_state constructor because
+// it can directly create the "." and ".." when initiated.
 void directory::insert_dir_ (const string& key, const inode_ptr& value) {
-   inode_ptr value_ = value;
-   if (dirents.find(key) != dirents.end()) {
-      dirents.at(key).reset();
-      dirents.erase(key);
-   }
-   dirents.insert({key, value_});
+   if (key == "." or key == "..")
+      dirents.assign(key, inode_ptr::link(value));
+   else
+      dirents.assign(key, value);
 }
 
 void directory::init_dir (const string& dir, const inode_ptr& current, const inode_ptr& parent) {
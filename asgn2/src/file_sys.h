@@ -1,12 +1,15 @@
-// $Id: file_sys.h,v 1.6 2018-06-27 14:44:57-07 - - $
+// $Id: file_sys.h,v 1.15 2026-10-17 12:00:00-07 - - $
 
 #ifndef __INODE_H__
 #define __INODE_H__
 
+#include <cstddef>
 #include <exception>
 #include <iostream>
 #include <memory>
 #include <map>
+#include <string>
+#include <unordered_map>
 #include <vector>
 #include <utility>
 using namespace std;
@@ -21,21 +24,75 @@ class inode;
 class base_file;
 class plain_file;
 class directory;
-using inode_ptr = shared_ptr<inode>;
 using base_file_ptr = shared_ptr<base_file>;
 ostream& operator<< (ostream&, file_type);
 
+// class inode_ptr -
+// A counted reference to an inode, kept in the inode itself.  When
+// the last one goes, the inode is freed by the inode_table.
+// link -
+//    A reference that is not counted.  This is how the . and .. of
+//    a directory refer to itself and its parent, which would
+//    otherwise keep each other alive.  A copy of a link is counted.
+// reset -
+//    Lets go of the inode, if any.
+
+class inode_ptr {
+   private:
+      inode* node {nullptr};
+      bool counted {true};
+      void release();
+   public:
+      inode_ptr() = default;
+      inode_ptr (nullptr_t) {}
+      explicit inode_ptr (inode* that);
+      inode_ptr (const inode_ptr& that);
+      inode_ptr (inode_ptr&& that) noexcept;
+      inode_ptr& operator= (const inode_ptr& that);
+      inode_ptr& operator= (inode_ptr&& that) noexcept;
+      ~inode_ptr() { release(); }
+      static inode_ptr link (const inode_ptr& that);
+      void reset() { release(); }
+      inode* get() const { return node; }
+      inode* operator-> () const { return node; }
+      inode& operator* () const { return *node; }
+      bool operator== (nullptr_t) const { return node == nullptr; }
+      bool operator!= (nullptr_t) const { return node != nullptr; }
+};
+ostream& operator<< (ostream&, const inode_ptr&);
+
 
 // inode_state -
 //    A small convenient class to maintain the state of the simulated
 //    process:  the root (/), the current directory (.), and the
 //    prompt.
+// canonical -
+//    The absolute form of a pathname, with . and .. taken out, as
+//    /a/b/c.  A relative pathname starts from the cwd, and the
+//    parent of / is / itself.
+// resolve -
+//    The inode a pathname names, or nullptr if any component of it
+//    does not exist or is a plain file with more path after it.
+//    A relative pathname is walked from the cwd inode, so that it
+//    still works in a cwd that has been removed.  Lookups of an
+//    absolute pathname are kept in a dentry cache by canonical
+//    pathname, so that a deep path is walked down from the deepest
+//    directory already known, and only once.
+// forget -
+//    Drops the cached lookups of a pathname and of everything under
+//    it.  Must be called whenever a name is removed, and is called
+//    as well when one is created.
+// set_cwd -
+//    Makes dir, found at the canonical pathname, the cwd.
 
 class inode_state {
    friend class inode;
    friend ostream& operator<< (ostream& out, const inode_state&);
    private:
       string prompt_ {"% "};
+      wordvec cwd_path;
+      unordered_map<string,inode_ptr> dentries;
+      inode_ptr lookup (const string& canonical_path);
    public:
       inode_ptr root {nullptr};
       inode_ptr cwd {nullptr};
@@ -45,11 +102,14 @@ class inode_state {
       const string& prompt() const;
       void set_prompt(const string& prompt);
       string get_prompt() const;
+      string canonical (const string& pathname) const;
+      inode_ptr resolve (const string& pathname);
+      void forget (const string& pathname);
+      void set_cwd (const inode_ptr& dir, const string& canonical_path);
 };
 
 // class inode -
-// inode ctor -
-//    Create a new inode of the given type.
+// Inodes are made only by the inode_table, with inode_table::make.
 // get_inode_nr -
 //    Retrieves the serial number of the inode.  Inode numbers are
 //    allocated in sequence by small integer.
@@ -62,16 +122,48 @@ class inode_state {
 
 class inode {
    friend class inode_state;
+   friend class inode_ptr;
+   friend class inode_table;
    private:
-      static int next_inode_nr;
-      int inode_nr;
+      int inode_nr {0};
+      size_t refs {0};
    public:
       base_file_ptr contents;
-      inode (file_type);
       int get_inode_nr() const;
       void dir_init(const string& dir, const inode_state& curr_dir);
 };
 
+// inode_table -
+//    A static class that holds every inode, in slabs of SLAB_SIZE
+//    allocated as they are needed, so that an inode never moves and
+//    a million of them take a few hundred allocations.  The contents
+//    of each inode are still allocated on their own.  The slot of a
+//    freed inode is kept and used again by the next one made.
+//    Inode numbers are not reused, since ls shows them and they have
+//    always been handed out in sequence, so a slot does not go with
+//    a number and the table can not be indexed by inode number.
+// make -
+//    A new inode of the given type, with the next inode number.
+// release -
+//    Frees an inode whose last counted reference has gone, along
+//    with its contents.  A directory releases its entries when it is
+//    freed, and the inodes that frees in turn are queued and freed by
+//    the same loop, so that tearing down a deep tree never recurses.
+
+class inode_table {
+   private:
+      static constexpr size_t SLAB_SIZE = 4096;
+      static vector<unique_ptr<inode[]>> slabs;
+      static size_t count;
+      static vector<inode*> free_slots;
+      static int next_inode_nr;
+      static vector<inode*> unreferenced;
+      static bool freeing;
+   public:
+      static inode_ptr make (file_type type);
+      static void release (inode* node);
+};
+
 
 // class base_file -
 // Just a base class at which an inode can point.  No data or
@@ -83,8 +175,71 @@ class file_error: public runtime_error {
       explicit file_error (const string& what);
 };
 
+// class dirent_table -
+// The entries of a directory, in a vector kept in name order so that
+// they list lexicographically, with a hash index from each name to
+// its position for lookups.  A new name is appended out of order and
+// a removed one leaves an empty slot, so that neither has to move
+// the rest of the vector.  order() sorts any new names in and drops
+// the empty slots, and must be called before iterating.  erase
+// calls it too, when the empty slots come to half of the names.
+// find -
+//    The slot holding a name, or nullptr.  Valid until the next
+//    insert, erase, or order.
+// insert -
+//    Adds a name, unless it is already there.  Returns whether it
+//    was added.
+// assign -
+//    Adds a name, or replaces what it already holds.
+// reserve -
+//    Makes room for count entries in all.
+
+class dirent_table {
+   public:
+      using dirent = pair<string,inode_ptr>;
+      using iterator = vector<dirent>::iterator;
+   private:
+      vector<dirent> entries;
+      unordered_map<string,size_t> index;
+      size_t sorted {0};
+   public:
+      size_t size() const { return index.size(); }
+      inode_ptr* find (const string& name);
+      bool insert (const string& name, inode_ptr node);
+      void assign (const string& name, inode_ptr node);
+      bool erase (const string& name);
+      void reserve (size_t count);
+      void order();
+      iterator begin() { return entries.begin(); }
+      iterator end() { return entries.end(); }
+};
+
+// class text_chunks -
+// The contents of a plain file:  its words with a space between each,
+// kept in chunks of at most CHUNK_SIZE chars, and its size, so that
+// the size is known without counting and no chunk is ever moved.
+// Text shorter than a chunk takes only its own size.
+// assign -
+//    Replaces the text with the words in a range.
+// write -
+//    Writes count chars from position pos, or to the end if there
+//    are fewer, straight from the chunks.
+
+class text_chunks {
+   private:
+      static constexpr size_t CHUNK_SIZE = 4096;
+      vector<string> chunks;
+      size_t size_ {0};
+   public:
+      size_t size() const { return size_; }
+      void assign (word_range words);
+      void write (ostream& out, size_t pos = 0,
+                  size_t count = string::npos) const;
+};
+ostream& operator<< (ostream&, const text_chunks&);
+
 struct dirents_itr {
-   map<string, inode_ptr>::iterator itr_b, itr_e;
+   dirent_table::iterator itr_b, itr_e;
 };
 
 class base_file {
@@ -95,11 +250,13 @@ class base_file {
       base_file (const base_file&) = delete;
       base_file& operator= (const base_file&) = delete;
       virtual size_t size() const = 0;
-      virtual const wordvec& readfile() const = 0;
-      virtual void writefile (const wordvec& newdata) = 0;
+      virtual const text_chunks& readfile() const = 0;
+      virtual void writefile (word_range newdata) = 0;
       virtual void remove (const string& filename) = 0;
       virtual inode_ptr mkdir (const string& dirname) = 0;
       virtual inode_ptr mkfile (const string& filename) = 0;
+      virtual void mkfiles (const wordvec& filenames) = 0;
+      virtual inode_ptr* entry (const string& key) = 0;
       virtual inode_ptr search_dir (const string& key) = 0;
       virtual bool find (const string& key) = 0;
       virtual dirents_itr get_itr () = 0;
@@ -117,23 +274,26 @@ class base_file {
 // class plain_file -
 // Used to hold data.
 // synthesized default ctor -
-//    Default vector<string> is a an empty vector.
+//    Default text_chunks is empty.
 // readfile -
-//    Returns a copy of the contents of the wordvec in the file.
+//    Returns the contents of the file, which can be written out
+//    without copying them.
 // writefile -
 //    Replaces the contents of a file with new contents.
 
 class plain_file: public base_file {
    private:
-      wordvec data;
+      text_chunks data;
       string name;
    public:
       virtual size_t size() const override;
-      virtual const wordvec& readfile() const override;
-      virtual void writefile (const wordvec& newdata) override;
+      virtual const text_chunks& readfile() const override;
+      virtual void writefile (word_range newdata) override;
       virtual void remove (const string& filename) override;
       virtual inode_ptr mkdir (const string& dirname) override;
       virtual inode_ptr mkfile (const string& filenane) override;
+      virtual void mkfiles (const wordvec& filenames) override;
+      virtual inode_ptr* entry (const string& key) override;
       virtual inode_ptr search_dir (const string& key) override;
       virtual bool find (const string& key) override;
       virtual dirents_itr get_itr () override;
@@ -165,19 +325,33 @@ class plain_file: public base_file {
 // mkfile -
 //    Create a new empty text file with the given name.  Error if
 //    a dirent with that name exists.
+// mkfiles -
+//    Creates a new empty text file for each name that is not in the
+//    directory yet, and sorts them into it in a single merge.
+// entry -
+//    The dirent holding the inode of a name, or nullptr.  The inode
+//    can be changed through it in place, as write_to_file and
+//    insert_dir do.  Valid until the directory next changes.
+// insert_dir_ -
+//    Adds or replaces an entry.  The entries . and .. are kept as
+//    links, and a directory that is removed drops them, so that a
+//    cwd left inside it cannot reach its freed parent.
 
 class directory: public base_file {
    private:
-      // Must be a map, not unordered_map, so printing is lexicographic
-      map<string,inode_ptr> dirents;
+      // Must keep name order, so printing is lexicographic
+      dirent_table dirents;
       wordvec path;
+      inode_ptr& at (const string& key);
    public:
       virtual size_t size() const override;
-      virtual const wordvec& readfile() const override;
-      virtual void writefile (const wordvec& newdata) override;
+      virtual const text_chunks& readfile() const override;
+      virtual void writefile (word_range newdata) override;
       virtual void remove (const string& filename) override;
       virtual inode_ptr mkdir (const string& dirname) override;
       virtual inode_ptr mkfile (const string& filename) override;
+      virtual void mkfiles (const wordvec& filenames) override;
+      virtual inode_ptr* entry (const string& key) override;
       virtual inode_ptr search_dir (const string& key) override;
       virtual bool find (const string& key) override;
       virtual dirents_itr get_itr () override;
@@ -1,4 +1,4 @@
-// $Id: main.cpp,v 1.9 2016-01-14 16:16:52-08 - - $
+// $Id: main.cpp,v 1.10 2026-10-17 12:00:00-07 - - $
 
 #include <cstdlib>
 #include <iostream>
@@ -74,6 +74,8 @@ int main (int argc, char** argv) {
             // If there is a problem discovered in any function, an
             // exn is thrown and printed here.
             complain() << error.what() << endl;
+         }catch (file_error& error) {
+            complain() << error.what() << endl;
          }
       }
    } catch (ysh_exit&) {